@@ -0,0 +1,194 @@
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "state.h"
+#include "player.h"
+#include "computer.hpp"
+
+// Reads one position per line, as the columns played from 1 to WIDTH
+// ("4453"), and writes for every line, in the input order:
+//   MOVES BEST_COL SCORE_1 ... SCORE_WIDTH NODES
+// columns counted from 1, 'x' for a full column. Lines that are not a game
+// in progress are written back followed by INVALID or DONE.
+// Positions are analysed on every thread, at most WINDOW lines are in
+// flight whatever the input size.
+struct Batch
+{
+    static constexpr size_t WINDOW {4096};
+
+    Batch(std::istream& input, std::ostream& output, const Computer::Options& options) :
+        _input(input), _output(output), _options(options), _jobs(WINDOW),
+        _read(0), _next(0), _written(0), _eof(false)
+    {}
+
+    void run(const unsigned threadCount)
+    {
+        std::vector<std::thread> threads;
+        for (unsigned thread=0; thread < threadCount; ++thread)
+        {
+            threads.emplace_back([this] { analyseLoop(); });
+        }
+        readLoop();
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+private:
+    struct Job
+    {
+        std::string line;
+        std::string result;
+        bool        done;
+    };
+
+    void readLoop()
+    {
+        std::string line;
+        while (std::getline(_input, line))
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _writtenCondition.wait(lock, [this] { return _read - _written < WINDOW; });
+            Job& job {_jobs[_read % WINDOW]};
+            job.line.swap(line);
+            job.done = false;
+            ++_read;
+            _readCondition.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _eof = true;
+        _readCondition.notify_all();
+    }
+
+    void analyseLoop()
+    {
+        std::string line;
+        std::string result;
+        while (true)
+        {
+            size_t index;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _readCondition.wait(lock, [this] { return _next < _read || _eof; });
+                if (_next == _read)
+                {
+                    return;
+                }
+                index = _next++;
+                line.swap(_jobs[index % WINDOW].line);
+            }
+
+            analyse(line, result);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            Job& job {_jobs[index % WINDOW]};
+            job.line.swap(line);
+            job.result.swap(result);
+            job.done = true;
+            write();
+        }
+    }
+
+    // the lines done from the oldest one written, in order
+    void write()
+    {
+        const size_t written {_written};
+        for (; _written < _read && _jobs[_written % WINDOW].done; ++_written)
+        {
+            Job& job {_jobs[_written % WINDOW]};
+            _output << job.line << job.result << '\n';
+        }
+        if (_written != written)
+        {
+            _output.flush();
+            _writtenCondition.notify_one();
+        }
+    }
+
+    void analyse(const std::string& line, std::string& result) const
+    {
+        State state(P1);
+        if (!state.addPositions(line))
+        {
+            result = " INVALID";
+            return;
+        }
+        if (state.isDone())
+        {
+            result = " DONE";
+            return;
+        }
+
+        const Computer::Analysis analysis {Computer::analyse(state, _options)};
+        result = " " + std::to_string(analysis.col + 1);
+        for (const int score : analysis.scores)
+        {
+            result += score == std::numeric_limits<int>::lowest() ? " x" : " " + std::to_string(score);
+        }
+        result += " " + std::to_string(analysis.nodes);
+    }
+
+    std::istream&            _input;
+    std::ostream&            _output;
+    const Computer::Options& _options;
+
+    std::mutex               _mutex;
+    std::condition_variable  _readCondition;    // a line was read, or the input ended
+    std::condition_variable  _writtenCondition; // a window slot was freed
+    std::vector<Job>         _jobs;
+    size_t                   _read;
+    size_t                   _next;
+    size_t                   _written;
+    bool                     _eof;
+};
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "USAGE: " << argv[0] << " RECURSION_LEVEL [INPUT_FILE|-] [THREADS] [TABLE_MB] [TABLEBASE_FILE]\n";
+        return 1;
+    }
+
+    Computer::Options options;
+    options.recursionLevel = std::stoul(argv[1]);
+    options.exactScores = true;
+    options.threads = 1; // the positions are analysed in parallel, each search on one thread
+    if (argc > 4)
+    {
+        options.tableSize = std::stoul(argv[4]) << 20;
+    }
+    if (argc > 5)
+    {
+        options.tablebaseFile = argv[5];
+    }
+    Computer::setup(options);
+
+    const unsigned threadCount {argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : std::max(1u, std::thread::hardware_concurrency())};
+
+    std::ios::sync_with_stdio(false);
+    if (argc > 2 && std::string{argv[2]} != "-")
+    {
+        std::ifstream input(argv[2]);
+        if (!input)
+        {
+            std::cout << "CANNOT READ " << argv[2] << "\n";
+            return 1;
+        }
+        Batch(input, std::cout, options).run(threadCount);
+    }
+    else
+    {
+        Batch(std::cin, std::cout, options).run(threadCount);
+    }
+
+    return 0;
+}
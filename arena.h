@@ -0,0 +1,80 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Scratch memory of the calling thread, for the objects a search needs while
+// it runs. Objects are created on top of a block reserved up front and given
+// back in stack order by Scope: a search touches the heap only the first
+// time its thread reserves more than the block holds.
+struct Arena
+{
+    // gives back everything created since its construction
+    struct Scope
+    {
+        explicit Scope(Arena& arena) : _arena(arena), _top(arena._top)
+        {}
+
+        ~Scope()
+        {
+            _arena._top = _top;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Arena&       _arena;
+        const size_t _top;
+    };
+
+    static Arena& get()
+    {
+        thread_local Arena arena;
+        return arena;
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // grows the block to at least size bytes, while nothing is created
+    void reserve(const size_t size)
+    {
+        assert(_top == 0);
+        if (size > _size)
+        {
+            _block.reset(new unsigned char[size]);
+            _size = size;
+        }
+    }
+
+    // an object in the reserved block, left as is by Scope: T must not need
+    // its destructor. Objects of one type created in a row form an array.
+    template <typename T, typename... Args>
+    T& create(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "arena objects are at most new aligned");
+
+        const size_t begin {(_top + alignof(T) - 1) / alignof(T) * alignof(T)};
+        assert(begin + sizeof(T) <= _size);
+        T* object {new (_block.get() + begin) T(std::forward<Args>(args)...)};
+        _top = begin + sizeof(T);
+        return *object;
+    }
+
+private:
+    Arena() : _size(0), _top(0)
+    {}
+
+    std::unique_ptr<unsigned char[]> _block;
+    size_t                           _size;
+    size_t                           _top;  // first free byte
+};
+
+#endif
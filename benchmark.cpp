@@ -0,0 +1,401 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "state.h"
+#include "player.h"
+#include "computer.hpp"
+#include "evaluator.h"
+
+// Every operator new of the process is counted
+static std::atomic<uint64_t> allocationCount {0};
+
+void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size == 0 ? 1 : size))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+// Times the engine hot paths over a position corpus, one move string per
+// line, and writes one JSON object per benchmark: the output of two builds
+// can be diffed line by line. It fails when a measured round allocates or
+// when a vector kernel of the Evaluator differs from the scalar one.
+struct Benchmark
+{
+    using Clock = std::chrono::steady_clock;
+
+    Benchmark(const std::vector<State>& states, const std::chrono::milliseconds minTime) :
+        _states(states), _minTime(minTime), _sink(0), _failed(false)
+    {}
+
+    void run(const std::string& filter)
+    {
+        // every child of the corpus, for the functions called after a move
+        std::vector<std::pair<State, unsigned>> children;
+        for (const State& state : _states)
+        {
+            for (unsigned col=0; col < WIDTH; ++col)
+            {
+                if (state.isColValid(col))
+                {
+                    children.emplace_back(state, col);
+                    children.back().first.addPosition(col);
+                }
+            }
+        }
+
+        measure(filter, "Board::isDone", [this]
+        {
+            for (const State& state : _states)
+            {
+                _sink += state.getBoard().isDone(P1) + state.getBoard().isDone(P2);
+            }
+            return Result{2 * _states.size(), 0};
+        });
+
+        measure(filter, "Board::getTopRow", [this]
+        {
+            for (const State& state : _states)
+            {
+                for (unsigned col=0; col < WIDTH; ++col)
+                {
+                    _sink += state.getBoard().getTopRow(col);
+                }
+            }
+            return Result{WIDTH * _states.size(), 0};
+        });
+
+        measure(filter, "Computer::getEvaluation", [this]
+        {
+            for (const State& state : _states)
+            {
+                _sink += Computer::getEvaluation(state.getBoard(), P1).threats;
+                _sink += Computer::getEvaluation(state.getBoard(), P2).doubles;
+            }
+            return Result{2 * _states.size(), 0};
+        });
+
+        // both players of every position, as Computer::getEvaluation above
+        Evaluator::Batch batch;
+        batch.resize(_states.size());
+        for (size_t index=0; index < _states.size(); ++index)
+        {
+            batch.positions[index] = _states[index].getBoard().getPosition();
+            batch.masks[index] = _states[index].getBoard().getMask();
+        }
+        static constexpr const char* KERNEL_NAMES[] {"scalar", "sse4", "avx2"};
+        for (unsigned kernel=0; kernel <= static_cast<unsigned>(Evaluator::getKernel()); ++kernel)
+        {
+            checkKernel(filter, std::string("Evaluator::evaluate/") + KERNEL_NAMES[kernel], children, static_cast<Evaluator::Kernel>(kernel));
+        }
+        for (unsigned kernel=0; kernel <= static_cast<unsigned>(Evaluator::getKernel()); ++kernel)
+        {
+            measure(filter, std::string("Evaluator::evaluate/") + KERNEL_NAMES[kernel], [this, &batch, kernel]
+            {
+                Evaluator::evaluate(batch, static_cast<Evaluator::Kernel>(kernel));
+                _sink += batch.threats[0].back() + batch.doubles[1].back();
+                return Result{2 * _states.size(), 0};
+            });
+        }
+
+        measure(filter, "Computer::getScoreCol", [this, &children]
+        {
+            for (const auto& child : children)
+            {
+                _sink += Computer::getScoreCol(child.first, Computer::Weights{});
+            }
+            return Result{children.size(), 0};
+        });
+
+        for (const unsigned recursionLevel : {2u, 4u})
+        {
+            uint64_t nodes {0};
+            for (const State& state : _states)
+            {
+                nodes += getLegacyNodes(state, recursionLevel);
+            }
+            measure(filter, "Computer::getScores/" + std::to_string(recursionLevel), [this, nodes, recursionLevel]
+            {
+                for (const State& state : _states)
+                {
+                    _sink += Computer::getScores(state, state.getTurn(), recursionLevel, Computer::Weights{}).max();
+                }
+                return Result{_states.size(), nodes};
+            });
+        }
+
+        for (const unsigned recursionLevel : {4u, 8u})
+        {
+            Computer::Options options;
+            options.recursionLevel = recursionLevel;
+            options.threads = 1;
+            Computer::setup(options);
+            measure(filter, "Computer::analyse/" + std::to_string(recursionLevel), [this, options]
+            {
+                uint64_t nodes {0};
+                for (const State& state : _states)
+                {
+                    const Computer::Analysis analysis {Computer::analyse(state, options)};
+                    _sink += analysis.col;
+                    nodes += analysis.nodes;
+                }
+                return Result{_states.size(), nodes};
+            }, []
+            {
+                Computer::_table.clear();
+            });
+        }
+
+        // one corpus through every window mode, compared by nodes_per_op
+        static constexpr const char* WINDOW_NAMES[] {"full", "pvs", "aspiration", "mtdf"};
+        for (const Computer::Window window : {Computer::Window::FULL, Computer::Window::PVS,
+                                              Computer::Window::ASPIRATION, Computer::Window::MTDF})
+        {
+            Computer::Options options;
+            options.recursionLevel = 8;
+            options.threads = 1;
+            options.window = window;
+            Computer::setup(options);
+            measure(filter, std::string("Computer::analyse/8/") + WINDOW_NAMES[static_cast<unsigned>(window)], [this, options]
+            {
+                uint64_t nodes {0};
+                for (const State& state : _states)
+                {
+                    const Computer::Analysis analysis {Computer::analyse(state, options)};
+                    _sink += analysis.col;
+                    nodes += analysis.nodes;
+                }
+                return Result{_states.size(), nodes};
+            }, []
+            {
+                Computer::_table.clear();
+            });
+        }
+
+        // the pool searches of getCol, on a fixed thread count so that builds compare
+        for (const Computer::Parallel parallel : {Computer::Parallel::SPLIT, Computer::Parallel::LAZY_SMP})
+        {
+            Computer::Options options;
+            options.recursionLevel = 8;
+            options.threads = 4;
+            options.parallel = parallel;
+            Computer::setup(options);
+            const std::string name {parallel == Computer::Parallel::SPLIT ? "split" : "lazy_smp"};
+            measure(filter, "Computer::getSearchScores/" + name, [this, options]
+            {
+                const uint64_t nodesBegin {Telemetry::getTotal().nodes};
+                for (const State& state : _states)
+                {
+                    Computer::Search search(state, options.parallel == Computer::Parallel::SPLIT, 0, options.ordering,
+                                            options.window, options.exactScores, options.weights);
+                    unsigned recursionLevel;
+                    _sink += Computer::getSearchScores(search, state, options, recursionLevel).getBestCol();
+                }
+                return Result{_states.size(), Telemetry::getTotal().nodes - nodesBegin};
+            }, []
+            {
+                Computer::_table.clear();
+            });
+        }
+
+        std::cerr << "SINK " << _sink << "\n";
+    }
+
+    // a measured round allocated, or a kernel differed from the scalar one
+    bool hasFailed() const
+    {
+        return _failed;
+    }
+
+private:
+    struct Result
+    {
+        uint64_t ops;
+        uint64_t nodes;
+    };
+
+    // Repeats f until it has run minTime, after a warm-up round. reset runs
+    // before every round, untimed. Only the warm-up round may allocate: the
+    // engine allocates nothing once initialized.
+    void measure(const std::string& filter, const std::string& name, const std::function<Result()>& f,
+                 const std::function<void()>& reset = [] {})
+    {
+        if (name.find(filter) == std::string::npos)
+        {
+            return;
+        }
+
+        reset();
+        f();
+
+        uint64_t ops {0};
+        uint64_t nodes {0};
+        uint64_t rounds {0};
+        uint64_t allocations {0};
+        Clock::duration time {0};
+        do
+        {
+            reset();
+            const uint64_t allocationBegin {allocationCount.load(std::memory_order_relaxed)};
+            const auto timeBegin {Clock::now()};
+            const Result result {f()};
+            time += Clock::now() - timeBegin;
+            allocations += allocationCount.load(std::memory_order_relaxed) - allocationBegin;
+            ops += result.ops;
+            nodes += result.nodes;
+            ++rounds;
+        }
+        while (time < _minTime);
+
+        const double ns {static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count())};
+        std::cout << "{\"benchmark\":\"" << name << "\""
+                  << ",\"rounds\":" << rounds
+                  << ",\"ops\":" << ops
+                  << ",\"ns_per_op\":" << ns / ops
+                  << ",\"nodes_per_sec\":" << (nodes == 0 ? 0.0 : nodes * 1e9 / ns)
+                  << ",\"nodes_per_op\":" << static_cast<double>(nodes) / ops
+                  << ",\"allocations_per_op\":" << static_cast<double>(allocations) / ops
+                  << "}" << std::endl;
+        if (allocations != 0)
+        {
+            std::cerr << "FAILED " << name << " allocated " << allocations << " times in " << rounds << " rounds\n";
+            _failed = true;
+        }
+    }
+
+    // Evaluates the corpus and its children with kernel and with the scalar
+    // kernel, every result must be the same
+    void checkKernel(const std::string& filter, const std::string& name, const std::vector<std::pair<State, unsigned>>& children,
+                     const Evaluator::Kernel kernel)
+    {
+        if (kernel == Evaluator::Kernel::SCALAR || name.find(filter) == std::string::npos)
+        {
+            return;
+        }
+
+        std::array<Evaluator::Batch, 2> batches;
+        for (Evaluator::Batch& batch : batches)
+        {
+            for (const State& state : _states)
+            {
+                batch.positions.push_back(state.getBoard().getPosition());
+                batch.masks.push_back(state.getBoard().getMask());
+            }
+            for (const auto& child : children)
+            {
+                batch.positions.push_back(child.first.getBoard().getPosition());
+                batch.masks.push_back(child.first.getBoard().getMask());
+            }
+            batch.resize(batch.positions.size());
+        }
+        Evaluator::evaluate(batches[0], Evaluator::Kernel::SCALAR);
+        Evaluator::evaluate(batches[1], kernel);
+
+        size_t mismatches {0};
+        for (size_t index=0; index < batches[0].size(); ++index)
+        {
+            for (unsigned player=0; player < 2; ++player)
+            {
+                if (batches[0].fours[player][index] != batches[1].fours[player][index] ||
+                    batches[0].threats[player][index] != batches[1].threats[player][index] ||
+                    batches[0].doubles[player][index] != batches[1].doubles[player][index])
+                {
+                    ++mismatches;
+                }
+            }
+        }
+        if (mismatches != 0)
+        {
+            std::cerr << "FAILED " << name << " differs from the scalar kernel for " << mismatches << " of "
+                      << 2 * batches[0].size() << " evaluations\n";
+            _failed = true;
+        }
+    }
+
+    // nodes of the getScores tree, the positions getScoreColRec plays
+    static uint64_t getLegacyNodes(const State& state, const unsigned recursionLevel)
+    {
+        if (recursionLevel == 0)
+        {
+            return 0;
+        }
+
+        // a symmetric position plays one of two mirrored columns
+        const bool symmetric {state.getBoard().isSymmetric()};
+        uint64_t nodes {0};
+        for (unsigned col=0; col < WIDTH; ++col)
+        {
+            if (!state.isColValid(col) || (symmetric && WIDTH - 1 - col < col))
+            {
+                continue;
+            }
+
+            State nextState {state};
+            nextState.addPosition(col);
+            ++nodes;
+            if (!Computer::isFinalScore(Computer::getScoreCol(nextState, Computer::Weights{}), Computer::Weights{}))
+            {
+                nodes += getLegacyNodes(nextState, recursionLevel - 1);
+            }
+        }
+        return nodes;
+    }
+
+    const std::vector<State>&       _states;
+    const std::chrono::milliseconds _minTime;
+    volatile uint64_t               _sink; // keeps the results alive
+    bool                            _failed;
+};
+
+int main(int argc, char** argv)
+{
+    const std::string fileName {argc > 1 ? argv[1] : "benchmark.txt"};
+    const std::chrono::milliseconds minTime {argc > 2 ? std::stoul(argv[2]) : 500};
+    const std::string filter {argc > 3 ? argv[3] : ""};
+
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        std::cout << "USAGE: " << argv[0] << " [CORPUS_FILE] [MIN_TIME_MS] [FILTER]\n";
+        return 1;
+    }
+
+    std::vector<State> states;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        State state(P1);
+        if (!state.addPositions(line))
+        {
+            std::cout << "CANNOT READ " << fileName << " LINE " << states.size() + 1 << ": " << line << "\n";
+            return 1;
+        }
+        states.push_back(state);
+    }
+
+    Benchmark benchmark(states, minTime);
+    benchmark.run(filter);
+
+    return benchmark.hasFailed() ? 1 : 0;
+}
@@ -1,138 +1,310 @@
 #ifndef BOARD_H
 #define BOARD_H
 
+#include "player.h"
+
+#include <algorithm>
 #include <array>
-#include <bitset>
+#include <cstdint>
 #include <iostream>
+#include <type_traits>
 
 constexpr unsigned WIDTH  = 7;
 constexpr unsigned HEIGHT = 6;
 
 constexpr char EMPTY = ' ';
 
-struct Board : std::array<std::array<char, WIDTH>, HEIGHT>
+// Bitboard layout, here 7x6: one bit per cell, column major, with an extra sentinel
+// bit on top of every column so that shifts never wrap between columns.
+//
+//  6 13 20 27 34 41 48
+//  5 12 19 26 33 40 47
+//  4 11 18 25 32 39 46
+//  3 10 17 24 31 38 45
+//  2  9 16 23 30 37 44
+//  1  8 15 22 29 36 43
+//  0  7 14 21 28 35 42
+//
+// _position holds the stones of the player to move (_pTurn), _mask holds
+// every stone on the board. Every geometry is its own type, its masks and
+// loops are compile-time constants; boards of more than 64 bits use 128-bit
+// bitboards.
+template <unsigned W, unsigned H>
+struct BasicBoard
 {
-    Board()
+    static constexpr unsigned WIDTH {W};
+    static constexpr unsigned HEIGHT {H};
+    static constexpr unsigned KEY_BITS {WIDTH * (HEIGHT + 1)};
+
+    using Bitboard = typename std::conditional<KEY_BITS <= 64, uint64_t, unsigned __int128>::type;
+
+    static_assert(KEY_BITS <= 128, "board does not fit in a 128-bit bitboard");
+    static_assert(WIDTH * HEIGHT <= 255, "moves are counted on 8 bits");
+
+    // read-only view of a row, keeps board[row][col] working
+    struct Row
     {
-        for (unsigned row = 0; row < HEIGHT; ++row)
+        char operator[](unsigned col) const
         {
-            for (unsigned col=0; col < WIDTH; ++col)
-            {
-                (*this)[row][col] = EMPTY;
-            }
+            return _board.getCell(_row, col);
+        }
+
+        const BasicBoard& _board;
+        const unsigned    _row;
+    };
+
+    BasicBoard() : _position(0), _mask(0), _heights{}, _pTurn(P0)
+    {}
+
+    Row operator[](unsigned row) const
+    {
+        return Row{*this, row};
+    }
+
+    char getCell(unsigned row, unsigned col) const
+    {
+        const Bitboard cell {cellMask(row, col)};
+        if ((_mask & cell) == 0)
+        {
+            return EMPTY;
         }
+        return (_position & cell) ? _pTurn : getOpponent(_pTurn);
     }
 
     bool isColValid(unsigned col) const
     {
-        return (*this)[HEIGHT - 1][col] == EMPTY;
+        return _heights[col] < HEIGHT;
     }
 
     unsigned getTopRow(unsigned col) const
     {
-        for (unsigned row=0; row < WIDTH; ++row)
-        {
-            if ((*this)[row][col] == EMPTY)
-            {
-                return row;
-            }
-        }
-        return HEIGHT - 1;
+        return isColValid(col) ? _heights[col] : HEIGHT - 1;
     }
 
     bool addPosition(unsigned col, char player)
     {
         if (isColValid(col))
         {
-            (*this)[getTopRow(col)][col] = player;
+            if (player != _pTurn)
+            {
+                // switch the point of view, the stones to move become player's
+                _position ^= _mask;
+                _pTurn = player;
+            }
+            _position ^= _mask;
+            _mask |= _mask + bottomMask(col);
+            ++_heights[col];
+            _pTurn = getOpponent(player);
             return true;
         }
         return false;
     }
 
+    // removes the top stone of col, its player is to move again
+    void removePosition(unsigned col)
+    {
+        --_heights[col];
+        _mask ^= cellMask(_heights[col], col);
+        _position ^= _mask;
+        _pTurn = getOpponent(_pTurn);
+    }
+
+    unsigned getHeight(unsigned col) const
+    {
+        return _heights[col];
+    }
+
     bool isDone(char player) const
     {
-        // check col
-        for (unsigned row=0; row < 3; ++row)
+        return isAligned(getStones(player));
+    }
+
+    bool isFull() const
+    {
+        return _mask == boardMask();
+    }
+
+    Bitboard getStones(char player) const
+    {
+        return player == _pTurn ? _position : _position ^ _mask;
+    }
+
+    Bitboard getPosition() const
+    {
+        return _position;
+    }
+
+    Bitboard getMask() const
+    {
+        return _mask;
+    }
+
+    // unique per position, seen from the player to move
+    Bitboard getKey() const
+    {
+        return _position + _mask;
+    }
+
+    // getKey in 64 bits, the key itself when it fits
+    uint64_t getHash() const
+    {
+        return getHash(getKey());
+    }
+
+    static uint64_t getHash(Bitboard key)
+    {
+        if (KEY_BITS <= 64)
         {
-            for (unsigned col=0; col < WIDTH; ++col)
-            {
-                if ((*this)[row  ][col] == player &&
-                    (*this)[row+1][col] == player &&
-                    (*this)[row+2][col] == player &&
-                    (*this)[row+3][col] == player)
-                {
-                    return true;
-                }
-            }
+            return static_cast<uint64_t>(key);
+        }
+        // the high half mixed into the low one, murmur3 finalizer
+        uint64_t hash {static_cast<uint64_t>(key >> 32 >> 32)};
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return static_cast<uint64_t>(key) ^ hash;
+    }
+
+    // Positions mirrored left to right score the same: they share the lower
+    // of their two keys. isMirrored tells it is the key of the mirror, whose
+    // column col is WIDTH - 1 - col here.
+    Bitboard getCanonicalKey() const
+    {
+        const Bitboard key {getKey()};
+        return std::min(key, getMirror(key));
+    }
+
+    uint64_t getCanonicalHash() const
+    {
+        return getHash(getCanonicalKey());
+    }
+
+    bool isMirrored() const
+    {
+        const Bitboard key {getKey()};
+        return getMirror(key) < key;
+    }
+
+    bool isSymmetric() const
+    {
+        const Bitboard key {getKey()};
+        return getMirror(key) == key;
+    }
+
+    // the columns of cells in reverse order, sentinel bits included
+    static Bitboard getMirror(Bitboard cells)
+    {
+        constexpr Bitboard column {(Bitboard{1} << (HEIGHT + 1)) - 1};
+        Bitboard mirror {0};
+        for (unsigned col=0; col < WIDTH; ++col)
+        {
+            mirror |= ((cells >> (col * (HEIGHT + 1))) & column) << ((WIDTH - 1 - col) * (HEIGHT + 1));
         }
+        return mirror;
+    }
+
+    static unsigned getCount(Bitboard cells)
+    {
+        return __builtin_popcountll(static_cast<uint64_t>(cells)) +
+               (KEY_BITS <= 64 ? 0 : __builtin_popcountll(static_cast<uint64_t>(cells >> 32 >> 32)));
+    }
+
+    // lowest empty cell of every column not full
+    Bitboard getPlayableCells() const
+    {
+        return (_mask + bottomMask()) & boardMask();
+    }
 
-        // check row
-        for (unsigned row=0; row < HEIGHT; ++row)
+    // empty cells where one more stone aligns four
+    static Bitboard getWinningCells(Bitboard stones, Bitboard mask)
+    {
+        // vertical
+        Bitboard cells {(stones << 1) & (stones << 2) & (stones << 3)};
+
+        for (const unsigned shift : {HEIGHT + 1, HEIGHT, HEIGHT + 2}) // horizontal, diagonal, anti diagonal
         {
-            for (unsigned col=0; col < 4; ++col)
-            {
-                if ((*this)[row][col  ] == player &&
-                    (*this)[row][col+1] == player &&
-                    (*this)[row][col+2] == player &&
-                    (*this)[row][col+3] == player)
-                {
-                    return true;
-                }
-            }
+            Bitboard pair {(stones << shift) & (stones << (2 * shift))};
+            cells |= pair & (stones << (3 * shift));
+            cells |= pair & (stones >> shift);
+            pair = (stones >> shift) & (stones >> (2 * shift));
+            cells |= pair & (stones << shift);
+            cells |= pair & (stones >> (3 * shift));
         }
 
-        // check diag
-        for (unsigned row=0; row < 3; ++row)
+        return cells & (boardMask() ^ mask);
+    }
+
+    static bool isAligned(Bitboard stones)
+    {
+        // horizontal
+        Bitboard m {stones & (stones >> (HEIGHT + 1))};
+        if (m & (m >> (2 * (HEIGHT + 1))))
         {
-            for (unsigned col=0; col < 4; ++col)
-            {
-                if ((*this)[row  ][col  ] == player &&
-                    (*this)[row+1][col+1] == player &&
-                    (*this)[row+2][col+2] == player &&
-                    (*this)[row+3][col+3] == player)
-                {
-                    return true;
-                }
-            }
+            return true;
         }
-        for (unsigned row=0; row < 3; ++row)
+
+        // diagonal
+        m = stones & (stones >> HEIGHT);
+        if (m & (m >> (2 * HEIGHT)))
         {
-            for (unsigned col=3; col < WIDTH; ++col)
-            {
-                if ((*this)[row  ][col  ] == player &&
-                    (*this)[row+1][col-1] == player &&
-                    (*this)[row+2][col-2] == player &&
-                    (*this)[row+3][col-3] == player)
-                {
-                    return true;
-                }
-            }
+            return true;
+        }
+
+        // anti diagonal
+        m = stones & (stones >> (HEIGHT + 2));
+        if (m & (m >> (2 * (HEIGHT + 2))))
+        {
+            return true;
+        }
+
+        // vertical
+        m = stones & (stones >> 1);
+        if (m & (m >> 2))
+        {
+            return true;
         }
 
         return false;
     }
 
-    bool isFull() const
+    static constexpr Bitboard cellMask(unsigned row, unsigned col)
     {
-        for (unsigned row=0; row < HEIGHT; ++row)
+        return Bitboard{1} << (col * (HEIGHT + 1) + row);
+    }
+
+    static constexpr Bitboard bottomMask(unsigned col)
+    {
+        return cellMask(0, col);
+    }
+
+    static constexpr Bitboard bottomMask()
+    {
+        Bitboard mask {0};
+        for (unsigned col=0; col < WIDTH; ++col)
         {
-            for (unsigned col=0; col < WIDTH; ++col)
-            {
-                if ((*this)[row][col] == EMPTY)
-                {
-                    return false;
-                }
-            }
+            mask |= bottomMask(col);
         }
+        return mask;
+    }
 
-        return true;
+    static constexpr Bitboard columnMask(unsigned col)
+    {
+        return ((Bitboard{1} << HEIGHT) - 1) << (col * (HEIGHT + 1));
     }
 
+    static constexpr Bitboard boardMask()
+    {
+        Bitboard mask {0};
+        for (unsigned col=0; col < WIDTH; ++col)
+        {
+            mask |= columnMask(col);
+        }
+        return mask;
+    }
 
-    friend std::ostream& operator<<(std::ostream& os, const Board& board)
+    friend std::ostream& operator<<(std::ostream& os, const BasicBoard& board)
     {
-        os << "|-|-|-|-|-|-|-|\n";
+        printBorder(os);
         for (int row = HEIGHT - 1; row >= 0; --row)
         {
             for (unsigned col=0; col < WIDTH; ++col)
@@ -141,9 +313,26 @@ struct Board : std::array<std::array<char, WIDTH>, HEIGHT>
             }
             os << "|\n";
         }
-        os << "|-|-|-|-|-|-|-|\n";
+        printBorder(os);
         return os;
     }
+
+private:
+    static void printBorder(std::ostream& os)
+    {
+        for (unsigned col=0; col < WIDTH; ++col)
+        {
+            os << "|-";
+        }
+        os << "|\n";
+    }
+
+    Bitboard                         _position;
+    Bitboard                         _mask;
+    std::array<uint8_t, WIDTH>       _heights;
+    char                             _pTurn;
 };
 
+using Board = BasicBoard<WIDTH, HEIGHT>;
+
 #endif
@@ -0,0 +1,84 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sortedfile.h"
+
+// Read-only table of solved positions: a header followed by entries sorted
+// by key. The file is mapped as is, opening it costs no parsing and a probe
+// is a binary search over the mapping.
+struct Book
+{
+    static constexpr char MAGIC[8] {'C', '4', 'B', 'O', 'O', 'K', '2', '\0'};
+
+    struct Header
+    {
+        char     magic[8];
+        uint32_t width;
+        uint32_t height;
+        uint32_t plies;          // positions up to plies stones
+        uint32_t recursionLevel; // of the search that solved them
+        uint64_t entryCount;
+    };
+    static_assert(sizeof(Header) == 32, "header must stay 32 bytes");
+
+    struct Entry
+    {
+        uint64_t key;   // Board::getCanonicalHash, one entry for a position and its mirror
+        int32_t  score; // of col, seen from the player to move
+        uint8_t  col;   // of the position whose key it is, mirrored for the other
+        uint8_t  padding[3];
+    };
+    static_assert(sizeof(Entry) == 16, "entry must stay 16 bytes");
+
+    // maps fileName, a no-op when it is already open
+    bool open(const std::string& fileName, unsigned width, unsigned height)
+    {
+        return _file.open(fileName, MAGIC, width, height);
+    }
+
+    void close()
+    {
+        _file.close();
+    }
+
+    bool isOpen() const
+    {
+        return _file.isOpen();
+    }
+
+    const Header& getHeader() const
+    {
+        return _file.getHeader();
+    }
+
+    bool probe(uint64_t key, Entry& result) const
+    {
+        const Entry* const entry {_file.find(key, getKey)};
+        if (entry == nullptr)
+        {
+            return false;
+        }
+        result = *entry;
+        return true;
+    }
+
+    // sorted and written as SortedFile::write writes them
+    static bool write(const std::string& fileName, Header header, std::vector<Entry>& entries)
+    {
+        return SortedFile<Header, Entry>::write(fileName, MAGIC, header, entries, getKey);
+    }
+
+private:
+    static uint64_t getKey(const Entry& entry)
+    {
+        return entry.key;
+    }
+
+    SortedFile<Header, Entry> _file;
+};
+
+#endif
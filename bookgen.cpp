@@ -0,0 +1,162 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "state.h"
+#include "player.h"
+#include "computer.hpp"
+
+// Every position up to plies stones, the game not done, each position or
+// its mirror once
+static std::vector<State> getPositions(const unsigned plies)
+{
+    std::vector<State> positions;
+    std::unordered_set<uint64_t> keys;
+    std::vector<State> ply {State(P1)};
+    for (unsigned stones=0; stones <= plies; ++stones)
+    {
+        std::vector<State> nextPly;
+        for (State& state : ply)
+        {
+            positions.push_back(state);
+            if (stones == plies)
+            {
+                continue;
+            }
+            for (unsigned col=0; col < WIDTH; ++col)
+            {
+                if (!state.isColValid(col))
+                {
+                    continue;
+                }
+                state.addPosition(col);
+                if (!state.isDone() && keys.insert(state.getBoard().getCanonicalHash()).second)
+                {
+                    nextPly.push_back(state);
+                }
+                state.undoPosition();
+            }
+        }
+        ply.swap(nextPly);
+    }
+    return positions;
+}
+
+// Entries solved by a previous run. A record cut by a crash is dropped and
+// truncated away, the next records are appended after the last whole one.
+static std::vector<Book::Entry> readCheckpoint(const std::string& fileName)
+{
+    std::vector<Book::Entry> entries;
+    {
+        std::ifstream file(fileName, std::ifstream::binary);
+        Book::Entry entry;
+        while (file.read(reinterpret_cast<char*>(&entry), sizeof(entry)))
+        {
+            entries.push_back(entry);
+        }
+        if (!file.is_open())
+        {
+            return entries;
+        }
+    }
+    truncate(fileName.c_str(), entries.size() * sizeof(Book::Entry));
+    return entries;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        std::cout << "USAGE: " << argv[0] << " BOOK_FILE PLIES RECURSION_LEVEL [THREADS]\n";
+        return 1;
+    }
+
+    const std::string fileName {argv[1]};
+    const std::string checkpointFileName {fileName + ".part"};
+
+    Computer::Options options;
+    options.recursionLevel = std::stoul(argv[3]);
+    options.threads = 1; // the positions are solved in parallel, each search on one thread
+    Computer::setup(options);
+
+    const unsigned plies = std::stoul(argv[2]);
+    const unsigned threadCount {argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : std::max(1u, std::thread::hardware_concurrency())};
+
+    std::vector<Book::Entry> entries {readCheckpoint(checkpointFileName)};
+    std::unordered_set<uint64_t> solved;
+    for (const Book::Entry& entry : entries)
+    {
+        solved.insert(entry.key);
+    }
+
+    std::vector<State> positions;
+    for (const State& state : getPositions(plies))
+    {
+        if (solved.count(state.getBoard().getCanonicalHash()) == 0)
+        {
+            positions.push_back(state);
+        }
+    }
+    std::cout << "POSITIONS=" << positions.size() + entries.size() << " CHECKPOINTED=" << entries.size() << "\n";
+
+    // every chunk is appended to the checkpoint as soon as it is solved
+    static constexpr size_t CHUNK_SIZE {64};
+    std::ofstream checkpoint(checkpointFileName, std::ofstream::binary | std::ofstream::app);
+    std::mutex checkpointMutex;
+    std::atomic<size_t> next {0};
+
+    const auto timeBegin {std::chrono::steady_clock::now()};
+    std::vector<std::thread> threads;
+    for (unsigned thread=0; thread < threadCount; ++thread)
+    {
+        threads.emplace_back([&]
+        {
+            std::vector<Book::Entry> chunk;
+            for (size_t begin {next.fetch_add(CHUNK_SIZE)}; begin < positions.size(); begin = next.fetch_add(CHUNK_SIZE))
+            {
+                chunk.clear();
+                for (size_t index=begin; index < std::min(begin + CHUNK_SIZE, positions.size()); ++index)
+                {
+                    const Board& board {positions[index].getBoard()};
+                    const Computer::Analysis analysis {Computer::analyse(positions[index], options)};
+                    const unsigned col {board.isMirrored() ? WIDTH - 1 - analysis.col : analysis.col};
+                    chunk.push_back(Book::Entry{board.getCanonicalHash(), analysis.score, static_cast<uint8_t>(col), {}});
+                }
+
+                std::lock_guard<std::mutex> lock(checkpointMutex);
+                checkpoint.write(reinterpret_cast<const char*>(chunk.data()), chunk.size() * sizeof(Book::Entry));
+                checkpoint.flush();
+                entries.insert(std::end(entries), std::begin(chunk), std::end(chunk));
+                std::cout << "\rSOLVED=" << entries.size() << std::flush;
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    checkpoint.close();
+
+    const std::chrono::duration<double> duration {std::chrono::steady_clock::now() - timeBegin};
+    std::cout << "\nSOLVED IN " << duration.count() << "s\n";
+
+    Book::Header header {};
+    header.width = WIDTH;
+    header.height = HEIGHT;
+    header.plies = plies;
+    header.recursionLevel = options.recursionLevel;
+    if (!Book::write(fileName, header, entries))
+    {
+        std::cout << "CANNOT WRITE " << fileName << "\n";
+        return 1;
+    }
+    std::remove(checkpointFileName.c_str());
+    std::cout << "BOOK " << fileName << " ENTRIES=" << entries.size() << "\n";
+
+    return 0;
+}
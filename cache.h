@@ -0,0 +1,490 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "durablefile.h"
+
+// Search results kept across processes in one file: a header, entries
+// sorted by key, then the entries appended since, in arrival order. The
+// sorted entries are mapped, the appended ones indexed in memory. add only
+// queues an entry and a writer thread appends it, so a search never waits
+// on the disk. Once the appended entries outnumber the sorted ones, the
+// writer compacts: it writes the merged entries next to the file, syncs
+// them and renames them over it, so a crash leaves either file whole. An
+// entry torn by a crash while appending fails its check and is cut at the
+// next open. One process at a time owns a file.
+struct ResultCache
+{
+    static constexpr char MAGIC[8] {'C', '4', 'C', 'A', 'C', 'H', 'E', '1'};
+    static constexpr size_t QUEUE_SIZE {1024};        // entries waiting for the writer, more are dropped
+    static constexpr size_t MIN_COMPACT_COUNT {4096}; // appended entries before the first compaction
+
+    struct Header
+    {
+        char     magic[8];
+        uint32_t width;
+        uint32_t height;
+        uint64_t sortedCount;
+        uint64_t reserved;
+    };
+    static_assert(sizeof(Header) == 32, "header must stay 32 bytes");
+
+    struct Entry
+    {
+        uint64_t key;
+        int32_t  score; // of col
+        uint8_t  depth; // of the search with FINAL, the deepest entry of a key wins
+        uint8_t  col;
+        uint16_t check; // of the other fields, set by add
+    };
+    static_assert(sizeof(Entry) == 16, "entry must stay 16 bytes");
+
+    // depth bit of an entry whose score no deeper search changes, it
+    // outranks every depth and getCheck covers it with the depth
+    static constexpr uint8_t FINAL {0x80};
+
+    ResultCache() : _fd(-1), _data(nullptr), _size(0), _width(0), _height(0), _sortedCount(0), _fileSize(0),
+        _queueBegin(0), _queueEnd(0), _pending(0), _stopped(false)
+    {}
+
+    ~ResultCache()
+    {
+        close();
+    }
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // opens or creates fileName, a no-op when it is already open
+    bool open(const std::string& fileName, unsigned width, unsigned height)
+    {
+        std::lock_guard<std::mutex> openLock(_openMutex);
+        return openFile(fileName, width, height);
+    }
+
+    // Opens fileName once, an empty name closes the cache: a no-op while the
+    // name stays the same, even when the file failed to open, so a file
+    // another process owns is not tried again on every search.
+    void setFile(const std::string& fileName, unsigned width, unsigned height)
+    {
+        std::lock_guard<std::mutex> openLock(_openMutex);
+        if (fileName == _setFileName)
+        {
+            return;
+        }
+        _setFileName = fileName;
+        if (fileName.empty())
+        {
+            closeFile();
+        }
+        else
+        {
+            openFile(fileName, width, height);
+        }
+    }
+
+    // once the queued entries are written
+    void close()
+    {
+        std::lock_guard<std::mutex> openLock(_openMutex);
+        _setFileName.clear();
+        closeFile();
+    }
+
+    bool isOpen() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _fd >= 0;
+    }
+
+    // the deepest entry of key
+    bool probe(uint64_t key, Entry& result) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_fd < 0)
+        {
+            return false;
+        }
+
+        bool found {false};
+        const Entry* const begin {getSortedEntries()};
+        const Entry* const end {begin + _sortedCount};
+        const Entry* const entry {std::lower_bound(begin, end, key, [](const Entry& lhs, uint64_t rhs)
+        {
+            return lhs.key < rhs;
+        })};
+        if (entry != end && entry->key == key)
+        {
+            result = *entry;
+            found = true;
+        }
+
+        const auto appended {_appended.find(key)};
+        if (appended != std::end(_appended) && (!found || appended->second.depth > result.depth))
+        {
+            result = appended->second;
+            found = true;
+        }
+        return found;
+    }
+
+    // queued for the writer, dropped when the queue is full
+    void add(Entry entry)
+    {
+        entry.check = getCheck(entry);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_fd < 0 || _queueEnd - _queueBegin == QUEUE_SIZE)
+            {
+                return;
+            }
+            _queue[_queueEnd++ % QUEUE_SIZE] = entry;
+            ++_pending;
+        }
+        _condition.notify_all();
+    }
+
+    // returns once the entries added so far are written and indexed
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this] { return _pending == 0; });
+    }
+
+    // sorted and appended entries
+    size_t getEntryCount() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _sortedCount + _appended.size();
+    }
+
+private:
+    static uint16_t getCheck(const Entry& entry)
+    {
+        uint64_t hash {(entry.key ^ 0x9e3779b97f4a7c15ull) * 0xff51afd7ed558ccdull};
+        hash ^= (static_cast<uint64_t>(static_cast<uint32_t>(entry.score)) << 16 |
+                 static_cast<uint64_t>(entry.depth) << 8 | entry.col) * 0xc4ceb9fe1a85ec53ull;
+        return static_cast<uint16_t>(hash >> 48);
+    }
+
+    const Entry* getSortedEntries() const
+    {
+        return reinterpret_cast<const Entry*>(static_cast<const Header*>(_data) + 1);
+    }
+
+    // Under _openMutex. _fd is read through isOpen: the writer swaps it under
+    // _mutex only when it compacts.
+    bool openFile(const std::string& fileName, unsigned width, unsigned height)
+    {
+        if (isOpen() && fileName == _fileName)
+        {
+            return true;
+        }
+        closeFile();
+
+        const int fd {::open(fileName.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644)};
+        if (fd < 0)
+        {
+            return false;
+        }
+        if (flock(fd, LOCK_EX | LOCK_NB) != 0 || !mapFile(fd, width, height))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        _fileName = fileName;
+        _stopped = false;
+        _writer = std::thread(&ResultCache::writeLoop, this);
+        return true;
+    }
+
+    // Checks the header of fd, cuts a torn tail, maps the sorted entries and
+    // indexes the appended ones. A new file gets its header.
+    bool mapFile(const int fd, unsigned width, unsigned height)
+    {
+        struct stat status;
+        if (fstat(fd, &status) != 0)
+        {
+            return false;
+        }
+
+        Header header {};
+        if (status.st_size == 0)
+        {
+            std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+            header.width = width;
+            header.height = height;
+            if (!DurableFile::writeAll(fd, &header, sizeof(header)) || fsync(fd) != 0)
+            {
+                return false;
+            }
+            status.st_size = sizeof(header);
+        }
+        else if (pread(fd, &header, sizeof(header), 0) != sizeof(header) ||
+                 std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.width != width || header.height != height ||
+                 static_cast<uint64_t>(status.st_size) < sizeof(Header) + header.sortedCount * sizeof(Entry))
+        {
+            return false;
+        }
+
+        const size_t sortedSize {sizeof(Header) + header.sortedCount * sizeof(Entry)};
+        std::vector<Entry> appended((status.st_size - sortedSize) / sizeof(Entry));
+        const ssize_t appendedSize {static_cast<ssize_t>(appended.size() * sizeof(Entry))};
+        if (pread(fd, appended.data(), appendedSize, sortedSize) != appendedSize)
+        {
+            return false;
+        }
+        size_t validCount {0};
+        while (validCount < appended.size() && appended[validCount].check == getCheck(appended[validCount]))
+        {
+            ++validCount;
+        }
+        const size_t fileSize {sortedSize + validCount * sizeof(Entry)};
+        if (fileSize != static_cast<size_t>(status.st_size) && ftruncate(fd, fileSize) != 0)
+        {
+            return false;
+        }
+
+        void* const data {mmap(nullptr, sortedSize, PROT_READ, MAP_SHARED, fd, 0)};
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(data, sortedSize, MADV_RANDOM);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _fd = fd;
+        _data = data;
+        _size = sortedSize;
+        _width = width;
+        _height = height;
+        _sortedCount = header.sortedCount;
+        _fileSize = fileSize;
+        _appended.clear();
+        for (size_t index=0; index < validCount; ++index)
+        {
+            addToIndex(appended[index]);
+        }
+        return true;
+    }
+
+    // the writer has written every queued entry when it stops
+    void closeFile()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopped = true;
+        }
+        _condition.notify_all();
+        if (_writer.joinable())
+        {
+            _writer.join();
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        releaseFile();
+        _fileName.clear();
+    }
+
+    // unmaps and closes the file, under _mutex
+    void releaseFile()
+    {
+        if (_data != nullptr)
+        {
+            munmap(_data, _size);
+        }
+        if (_fd >= 0)
+        {
+            ::close(_fd);
+        }
+        _fd = -1;
+        _data = nullptr;
+        _size = 0;
+        _sortedCount = 0;
+        _appended.clear();
+    }
+
+    // keeps the deepest entry of a key, under _mutex
+    void addToIndex(const Entry& entry)
+    {
+        Entry& indexed {_appended.emplace(entry.key, entry).first->second};
+        if (entry.depth > indexed.depth)
+        {
+            indexed = entry;
+        }
+    }
+
+    void writeLoop()
+    {
+        std::vector<Entry> batch;
+        batch.reserve(QUEUE_SIZE);
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, [this] { return _stopped || _queueBegin != _queueEnd; });
+                if (_queueBegin == _queueEnd)
+                {
+                    return;
+                }
+                batch.clear();
+                while (_queueBegin != _queueEnd)
+                {
+                    batch.push_back(_queue[_queueBegin++ % QUEUE_SIZE]);
+                }
+            }
+
+            // only this thread writes the file, a failed append is cut so the entries after it stay readable
+            const bool written {DurableFile::writeAll(_fd, batch.data(), batch.size() * sizeof(Entry))};
+            if (!written && ftruncate(_fd, _fileSize) != 0)
+            {
+                std::perror("ResultCache");
+            }
+
+            bool full;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                if (written)
+                {
+                    _fileSize += batch.size() * sizeof(Entry);
+                    for (const Entry& entry : batch)
+                    {
+                        addToIndex(entry);
+                    }
+                }
+                _pending -= batch.size();
+                full = _appended.size() >= std::max<size_t>(_sortedCount, MIN_COMPACT_COUNT);
+            }
+            _condition.notify_all();
+
+            if (full)
+            {
+                compact();
+            }
+        }
+    }
+
+    // On the writer thread: the mapping and the index only change here, so
+    // they are read without the lock until the new file replaces them.
+    bool compact()
+    {
+        std::vector<Entry> entries(getSortedEntries(), getSortedEntries() + _sortedCount);
+        for (const auto& appended : _appended)
+        {
+            entries.push_back(appended.second);
+        }
+        std::sort(std::begin(entries), std::end(entries), [](const Entry& lhs, const Entry& rhs)
+        {
+            return lhs.key < rhs.key || (lhs.key == rhs.key && lhs.depth > rhs.depth);
+        });
+        entries.erase(std::unique(std::begin(entries), std::end(entries), [](const Entry& lhs, const Entry& rhs)
+        {
+            return lhs.key == rhs.key;
+        }), std::end(entries));
+
+        Header header {};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.width = _width;
+        header.height = _height;
+        header.sortedCount = entries.size();
+
+        if (!DurableFile::replace(_fileName, [&header, &entries](const int fd)
+        {
+            return DurableFile::writeAll(fd, &header, sizeof(header)) &&
+                   DurableFile::writeAll(fd, entries.data(), entries.size() * sizeof(Entry));
+        }))
+        {
+            return false;
+        }
+
+        const int fd {::open(_fileName.c_str(), O_RDWR | O_APPEND)};
+        const size_t size {sizeof(Header) + entries.size() * sizeof(Entry)};
+        void* const data {fd < 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)};
+        if (data == MAP_FAILED || flock(fd, LOCK_EX | LOCK_NB) != 0)
+        {
+            // The renamed file holds every entry, the next open reads it. The
+            // open file is unlinked: the cache closes rather than append to
+            // it, the writer drops the queue and stops.
+            std::perror("ResultCache");
+            if (data != MAP_FAILED)
+            {
+                munmap(data, size);
+            }
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                releaseFile();
+                _queueBegin = _queueEnd;
+                _pending = 0;
+                _stopped = true;
+            }
+            _condition.notify_all();
+            return false;
+        }
+        madvise(data, size, MADV_RANDOM);
+
+        void* oldData;
+        size_t oldSize;
+        int oldFd;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            oldData = _data;
+            oldSize = _size;
+            oldFd = _fd;
+            _fd = fd;
+            _data = data;
+            _size = size;
+            _sortedCount = entries.size();
+            _fileSize = size;
+            _appended.clear();
+        }
+        munmap(oldData, oldSize);
+        ::close(oldFd);
+        return true;
+    }
+
+    std::mutex                             _openMutex; // serializes open and close
+    mutable std::mutex                     _mutex;
+    std::condition_variable                _condition;
+    std::thread                            _writer;
+    std::string                            _fileName;
+    std::string                            _setFileName; // of setFile, under _openMutex
+
+    int                                    _fd;
+    void*                                  _data;        // header and sorted entries
+    size_t                                 _size;
+    uint32_t                               _width;
+    uint32_t                               _height;
+    uint64_t                               _sortedCount;
+    size_t                                 _fileSize;    // written by the writer
+    std::unordered_map<uint64_t, Entry>    _appended;
+
+    std::array<Entry, QUEUE_SIZE>          _queue;
+    size_t                                 _queueBegin;
+    size_t                                 _queueEnd;
+    size_t                                 _pending;     // added, not yet indexed
+    bool                                   _stopped;
+};
+
+#endif
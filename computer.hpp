@@ -1,8 +1,15 @@
 #ifndef COMPUTER_HPP
 #define COMPUTER_HPP
 
+#include "arena.h"
 #include "board.h"
+#include "book.h"
+#include "cache.h"
 #include "player.h"
+#include "tablebase.h"
+#include "telemetry.h"
+#include "threadpool.h"
+#include "transposition.h"
 
 #include <limits>
 #include <algorithm>
@@ -13,58 +20,322 @@
 #include <mutex>
 #include <thread>
 #include <atomic>
-#include <future>
+#include <functional>
 
-struct Computer
+template <unsigned W, unsigned H>
+struct BasicComputer
 {
+    static constexpr unsigned WIDTH {W};
+    static constexpr unsigned HEIGHT {H};
+
+    using Board = BasicBoard<W, H>;
+    using State = BasicState<W, H>;
+    using Clock = std::chrono::steady_clock;
+
+    enum class Engine
+    {
+        LEGACY,  // exhaustive getScores recursion
+        NEGAMAX  // alpha-beta pruned search, same best column as LEGACY
+    };
+
+    enum class Parallel
+    {
+        SPLIT,    // young brothers wait splitting below the root
+        LAZY_SMP  // helper threads search the root at staggered levels, sharing the table
+    };
+
+    // NEGAMAX column order, every policy adds to the previous ones
+    enum class Ordering
+    {
+        NONE,    // columns 0 to WIDTH - 1
+        CENTER,  // from the center out
+        TABLE,   // table best column first
+        KILLERS, // then the columns that last cut off at the same ply
+        HISTORY  // then the other columns by cutoff history
+    };
+
+    // NEGAMAX search windows, ASPIRATION and MTDF search below the root as PVS does
+    enum class Window
+    {
+        FULL,       // every column searched with the window of its node
+        PVS,        // the columns after the first one tried with a null window first
+        ASPIRATION, // each level searched in a window around the previous level best score
+        MTDF        // each level closed in on with null windows from the previous level best score
+    };
+
+    // evaluation constants, the defaults are the legacy ones
+    struct Weights
+    {
+        int     forcedMove      {-10000}; // the opponent can complete four next
+        int     doubleTrapMove  {1000};   // two threats the opponent cannot both block
+        int     trapMove        {100};    // one threat
+        double  recursionFactor {1.5};    // a child score is divided by it at every level
+
+        bool operator==(const Weights& weights) const;
+        // The search tells the final scores by their values: the move scores
+        // must be distinct, not 0 as an open position, and inside the scores
+        // of a win. A factor below 1 would raise child scores past them, one
+        // above MAX_RECURSION_FACTOR overflows the child window of a bound.
+        bool isValid() const;
+
+        static constexpr double MAX_RECURSION_FACTOR {214};
+    };
+
+    struct Options
+    {
+        Engine                           engine         {Engine::NEGAMAX};
+        unsigned                         recursionLevel {4};
+        std::chrono::milliseconds        moveTime       {0};        // NEGAMAX deepens until then, 0 searches recursionLevel
+        unsigned                         threads        {std::max(1u, std::thread::hardware_concurrency())};
+        Parallel                         parallel       {Parallel::SPLIT};
+        Ordering                         ordering       {Ordering::KILLERS};
+        Window                           window         {Window::FULL};
+        size_t                           tableSize      {64 << 20}; // bytes, 0 disables the table
+        TranspositionTable::Replacement  replacement    {TranspositionTable::Replacement::AGE_DEPTH};
+        std::string                      bookFile;                  // answers the positions it holds, empty disables it
+        std::string                      cacheFile;                 // keeps the search results across processes, empty disables it
+        std::string                      tablebaseFile;             // scores the positions it holds exactly, empty disables it
+        bool                             exactScores    {false};    // NEGAMAX scores every column exactly, not only the best ones
+        std::string                      traceFile;                 // NEGAMAX writes its telemetry to traceFile_moves.json, empty disables the trace
+        Weights                          weights;
+    };
+
+    struct Analysis
+    {
+        unsigned                   col;
+        int                        score;
+        std::array<int, WIDTH>     scores; // lowest int for invalid columns, and for all but col in an answer of the cache
+        uint64_t                   nodes;  // 0 for an answer of the cache
+        unsigned                   recursionLevel; // of the scores
+    };
+
     static unsigned getCol(const State& state, const unsigned recursionLevel);
+    static unsigned getCol(const State& state, const Options& options);
+
+    // sizes the table and the pool, and the arena of the calling thread, and
+    // opens the cache and the tablebase of options
+    static void setup(const Options& options);
+
+    // NEGAMAX search of state on the calling thread only, without the book:
+    // tools solving many positions call it from several threads at once.
+    // An answer of the cache only scores its column.
+    static Analysis analyse(const State& state, const Options& options);
+
+    // While the opponent to move in state thinks, a background thread runs
+    // the NEGAMAX search getCol would run after each of its columns, in the
+    // center out order. stopPondering lets the search of the column played
+    // finish and aborts the others: getCol answers at once when that column
+    // was searched, and otherwise finds the ponder results in the table.
+    static void startPondering(const State& state, const Options& options);
+    static void stopPondering(const unsigned col);
+
+    // The NEGAMAX search of getCol, without the book and the output, on a
+    // background thread: startSearch returns at once and done is called on
+    // that thread when the search ends. stopSearch aborts it and returns
+    // once done has been called with the scores of the last completed
+    // level, the first level always completes. With moveTime 0 the search
+    // deepens up to recursionLevel.
+    static void startSearch(const State& state, const Options& options, const std::function<void(const Analysis&)>& done);
+    static void stopSearch();
 
 private:
-    struct Scores : std::array<int, WIDTH>
+    friend struct Benchmark;
+
+    using Score = int;
+    using Bitboard = typename Board::Bitboard;
+
+    struct Scores : std::array<Score, WIDTH>
     {
-        static constexpr value_type WIN_MOVE         { 1000000};
-        static constexpr value_type FORCED_MOVE      {-10000};
-        static constexpr value_type DOUBLE_TRAP_MOVE { 1000};
-        static constexpr value_type TRAP_MOVE        { 100};
-        static constexpr value_type INVALID_MOVE     {std::numeric_limits<value_type>::lowest()};
+        static constexpr Score WIN_MOVE         { 1000000};
+        static constexpr Score INVALID_MOVE     {std::numeric_limits<Score>::lowest()};
+        static constexpr Score INFINITE         {10 * WIN_MOVE}; // search window bound
+        static constexpr Score ASPIRATION       {50};            // half width of the first aspiration window
 
         Scores();
-        Scores(value_type i);
+        Scores(Score i);
 
         int max() const;
         unsigned getBestCol() const;
 
-        friend std::ostream& operator<<(std::ostream& os, const Scores& scores);
+        friend std::ostream& operator<<(std::ostream& os, const Scores& scores)
+        {
+            for (unsigned col=0; col < WIDTH; ++col)
+            {
+                os << "|" << scores[col];
+            }
+            os << "|\n";
+            return os;
+        }
+    };
+    // the preimages of a window bound below INFINITE fit in a Score
+    static_assert((Scores::INFINITE + 2) * Weights::MAX_RECURSION_FACTOR <= std::numeric_limits<Score>::max(),
+                  "MAX_RECURSION_FACTOR must keep the child windows in a Score");
+
+    // playable cells of one player, as the legacy char passes marked them
+    struct Evaluation
+    {
+        Bitboard threats; // 'F' or 'D': playing there completes four
+        Bitboard doubles; // 'D': threat under another 'F', counting from the top of the stack
     };
-    friend std::ostream& operator<<(std::ostream& os, Computer::Scores const& scores);
 
-    struct Log
+    static Scores getScores(const State& state, const char player, const unsigned recursionLevel, const Weights& weights, const bool multiThreading=false);
+
+    static int getScoreColRec(const State& state, const unsigned col, const char player, const unsigned recursionLevel, const Weights& weights);
+    static Score getScoreCol(const State& state, const Weights& weights);
+    static bool getFinalScoreCol(const State& state, const Weights& weights, Score& score);
+    static bool getScoreColTablebase(const State& state, const Weights& weights, Score& score);
+
+    // state of one negamax search, shared by the pool threads
+    struct Search
     {
-        static constexpr bool LOG_ENABLED {false};
+        static constexpr uint64_t CLOCK_CHECK_NODES {256};
+        static constexpr unsigned KILLER_COUNT {2};
 
-        explicit Log(const std::string& fileName);
+        struct Level
+        {
+            unsigned          recursionLevel;
+            Clock::duration   time;
+        };
+
+        Search(const State& state, const bool split, const unsigned rotation, const Ordering ordering,
+               const Window window, const bool exactScores, const Weights& weights);
+
+        void setDeadline(const Clock::time_point deadline);
+        void addNode(const State& state);
+        void addCutoff(const State& state, const unsigned col, const unsigned recursionLevel, const bool first);
+        void abort();
+        bool isAborted() const;
+
+        unsigned getKiller(const State& state, const unsigned index) const;
+        uint32_t getHistory(const State& state, const unsigned col) const;
 
-        template<typename T>
-        Log& operator<<(const T& t);
+        const char            player;
+        const unsigned        moveCount;   // stones at the root
+        const bool            split;       // search columns in parallel on the pool
+        const unsigned        rotation;    // root column order offset of a lazy SMP helper
+        const Ordering        ordering;
+        const Window          window;
+        const bool            exactScores; // root columns searched with a full window
+        const Weights         weights;
+        const uint64_t        tableTag;    // keeps the table entries of other weights apart
+        std::array<Level, WIDTH * HEIGHT> levels; // completed by the caller thread
+        unsigned              levelCount;
 
     private:
-        static unsigned _moveNumber;
-        std::ofstream _file;
+        unsigned getHistoryIndex(const State& state, const unsigned col) const;
+
+        bool                  _timed;
+        std::atomic<bool>     _aborted;
+        Clock::time_point     _deadline;
+
+        // shared by the pool threads: a lost update only changes the order
+        std::array<std::array<std::atomic<uint8_t>, KILLER_COUNT>, WIDTH * HEIGHT> _killers; // per ply
+        std::array<std::atomic<uint32_t>, 2 * WIDTH * HEIGHT>                      _history; // per side and cell
+    };
+
+    // the background search of the opponent's columns
+    struct Ponder
+    {
+        Ponder();
+        ~Ponder();
+
+        std::thread                     thread;
+        std::mutex                      mutex;
+        uint64_t                        key;             // of the pondered position, its moves count and its stones
+        unsigned                        moveCount;
+        Options                         options;
+        bool                            stopped;
+        unsigned                        col;             // searched now, WIDTH when none
+        Search*                         search;          // of col
+        std::array<bool, WIDTH>         done;            // the scores of a column are complete
+        std::array<Scores, WIDTH>       scores;
+        std::array<unsigned, WIDTH>     recursionLevels;
+    };
+
+    // the search of startSearch
+    struct Background
+    {
+        Background();
+        ~Background();
+
+        std::thread                           thread;
+        std::mutex                            mutex;
+        Options                               options;
+        std::function<void(const Analysis&)>  done;
+        bool                                  stopped;
+        Search*                               search; // while it runs
+    };
+
+    // node whose younger columns are searched in parallel once the eldest is done
+    struct SplitPoint
+    {
+        static constexpr unsigned MIN_RECURSION_LEVEL {3};
+        static constexpr unsigned TRACE_RECURSION_LEVEL {6}; // deeper split points would flood the trace
+
+        SplitPoint(const SplitPoint* parent, const Score alpha, const Score beta,
+                   const Score best, const unsigned bestCol);
+
+        bool isCutoff() const;
+        Score getAlpha();
+        void update(const unsigned col, const Score score);
+
+        const SplitPoint* const  parent;
+        const Score beta;
+        std::atomic<bool>        cutoff;
+        std::mutex               mutex;
+        Score       alpha;
+        Score       best;
+        unsigned                 bestCol;
     };
 
-    static Scores getScores(const State& state, const char player, const unsigned recursionLevel, Log& log, const bool multiThreading=false);
+    static Scores getSearchScores(Search& search, const State& state, const Options& options, unsigned& recursionLevel);
+    static void ponder(const State& state);
+    static bool isPondered(const State& state);
+    static void searchBackground(const State& state);
+    static Scores getIterativeScores(Search& search, const State& state, const Clock::time_point deadline, const unsigned maxRecursionLevel, unsigned& recursionLevel);
+    static Scores getDeepeningScores(Search& search, const State& state, const unsigned recursionLevel);
+    static Scores getWindowScores(Search& search, const State& state, const unsigned recursionLevel, const Scores& previousScores);
+    static Scores getNegamaxScores(Search& search, const State& state, const unsigned recursionLevel, const Scores& previousScores,
+                                   const Score alpha, const Score beta);
+    static Scores getLazySmpScores(Search& search, const State& state, const unsigned recursionLevel, const Scores& previousScores);
+    static Score negamax(Search& search, State& state, const unsigned recursionLevel, Score alpha, Score beta, const SplitPoint* splitPoint);
+    static Score getNegamaxScoreCol(Search& search, State& state, const unsigned col, const unsigned recursionLevel, const Score alpha, const Score beta, const SplitPoint* splitPoint);
+    static Score getPvsScoreCol(Search& search, State& state, const unsigned col, const unsigned recursionLevel, const Score alpha, const Score beta, const SplitPoint* splitPoint);
+    static bool isAborted(const Search& search, const SplitPoint* splitPoint);
+    static std::array<unsigned, WIDTH> getBaseColOrder(const Ordering ordering);
+    static unsigned getMirrorCol(const unsigned col);
+    static unsigned getColOrder(const Search& search, const State& state, const unsigned tableCol, std::array<unsigned, WIDTH>& cols);
+    template <typename Compare>
+    static void sortCols(unsigned* begin, unsigned* end, const Compare& compare);
 
-    static int getScoreColRec(const State& state, const unsigned col, const char player, const unsigned recursionLevel, Log& log);
-    static Scores::value_type getScoreCol(const State& state, unsigned const col, Log& log);
+    static bool getScoreColCached(const Search& search, const State& state, Score& score);
+    static uint64_t getTableKey(const Search& search, const State& state, bool& mirrored);
+    static uint64_t getTableTag(const Weights& weights);
+    static bool probeCache(const State& state, const Options& options, Analysis& analysis);
+    static void addToCache(const State& state, const Options& options, const Analysis& analysis);
 
-    static Board getEvaluationBoard(const Board& board, const char player, Log& log);
-    static void horizontalEvaluation(const Board& board, const char player, Board& evaluationBoard);
-    static void verticalEvaluation(const Board& board, const char player, Board& evaluationBoard);
-    static void diagonalEvaluation(const Board& board, const char player, Board& evaluationBoard);
-    static void doubleForceMoveEvaluation(const Board& board, const char player, Board& evaluationBoard);
+    // free bits between the board key and the top bit of the table keys
+    static constexpr unsigned TAG_BITS {Board::KEY_BITS < 63 ? 63 - Board::KEY_BITS : 0};
+    static constexpr unsigned MIN_TAG_BITS {8};
+
+    static bool isFinalScore(const Score score, const Weights& weights);
+    static Score getRecursionScore(const Score score, const Weights& weights);
+    static Score getMaxRecursionPreimage(const Score score, const Weights& weights);
+    static Score getMinRecursionPreimage(const Score score, const Weights& weights);
+
+    static Evaluation getEvaluation(const Board& board, const char player);
+
+    static TranspositionTable _table;
+    static ThreadPool         _pool;
+    static Book               _book;
+    static ResultCache        _cache;
+    static Tablebase          _tablebase;
+    static Ponder             _ponder;
+    static Background         _background;
 };
 
-Computer::Scores::Scores()
+template <unsigned W, unsigned H>
+BasicComputer<W, H>::Scores::Scores()
 {
     for(size_t col = 0; col < WIDTH; ++col)
     {
@@ -72,7 +343,8 @@ Computer::Scores::Scores()
     }
 }
 
-Computer::Scores::Scores(value_type i)
+template <unsigned W, unsigned H>
+BasicComputer<W, H>::Scores::Scores(Score i)
 {
     for(size_t col = 0; col < WIDTH; ++col)
     {
@@ -80,9 +352,10 @@ Computer::Scores::Scores(value_type i)
     }
 }
 
-int Computer::Scores::max() const
+template <unsigned W, unsigned H>
+int BasicComputer<W, H>::Scores::max() const
 {
-    value_type max {INVALID_MOVE};
+    Score max {INVALID_MOVE};
     for(size_t col = 0; col < WIDTH; ++col)
     {
         max = std::max(max, (*this)[col]);
@@ -90,419 +363,1452 @@ int Computer::Scores::max() const
     return max;
 }
 
-unsigned Computer::Scores::getBestCol() const
+template <unsigned W, unsigned H>
+unsigned BasicComputer<W, H>::Scores::getBestCol() const
 {
-    const value_type maxValue = max();
-    std::vector<unsigned> colSet;
-    for(size_t col = 0; col < WIDTH; ++col)
+    const Score maxValue = max();
+    std::array<unsigned, WIDTH> colSet;
+    unsigned colCount {0};
+    for(unsigned col = 0; col < WIDTH; ++col)
     {
         if ((*this)[col] == maxValue)
         {
-            if (col == 3)
+            if (col == WIDTH / 2)
             {
-                return 3;
+                return WIDTH / 2;
             }
-            colSet.emplace_back(col);
+            colSet[colCount++] = col;
         }
     }
 
-    if (colSet.size() == 1)
+    if (colCount == 1)
     {
         return colSet[0];
     }
 
-    std::shuffle(std::begin(colSet), std::end(colSet), std::default_random_engine{});
+    std::shuffle(std::begin(colSet), std::begin(colSet) + colCount, std::default_random_engine{});
     return colSet[0];
 }
 
-std::ostream& operator<<(std::ostream& os, const Computer::Scores& scores)
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::Weights::isValid() const
 {
-    for (unsigned col=0; col < WIDTH; ++col)
+    for (const int move : {forcedMove, doubleTrapMove, trapMove})
     {
-        os << "|" << scores[col];
+        if (move == 0 || move <= -Scores::WIN_MOVE || move >= Scores::WIN_MOVE)
+        {
+            return false;
+        }
     }
-    os << "|\n";
-    return os;
+    return forcedMove != doubleTrapMove && forcedMove != trapMove && doubleTrapMove != trapMove &&
+           recursionFactor >= 1 && recursionFactor <= MAX_RECURSION_FACTOR;
 }
 
-Computer::Log::Log(const std::string& fileName)
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::Weights::operator==(const Weights& weights) const
 {
-    if (LOG_ENABLED)
-    {
-        _file = std::ofstream(fileName + "_" + std::to_string(_moveNumber++), std::ofstream::out);
-    }
+    return forcedMove == weights.forcedMove && doubleTrapMove == weights.doubleTrapMove &&
+           trapMove == weights.trapMove && recursionFactor == weights.recursionFactor;
 }
 
-template<typename T>
-Computer::Log& Computer::Log::operator<<(const T& t)
+template <unsigned W, unsigned H>
+TranspositionTable BasicComputer<W, H>::_table;
+
+template <unsigned W, unsigned H>
+ThreadPool BasicComputer<W, H>::_pool;
+
+template <unsigned W, unsigned H>
+Book BasicComputer<W, H>::_book;
+template <unsigned W, unsigned H>
+ResultCache BasicComputer<W, H>::_cache;
+template <unsigned W, unsigned H>
+Tablebase BasicComputer<W, H>::_tablebase;
+
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Ponder BasicComputer<W, H>::_ponder;
+
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Background BasicComputer<W, H>::_background;
+
+template <unsigned W, unsigned H>
+unsigned BasicComputer<W, H>::getCol(const State& state, const unsigned recursionLevel)
 {
-    if (LOG_ENABLED)
-    {
-        _file << t;
-    }
-    return *this;
+    Options options;
+    options.recursionLevel = recursionLevel;
+    return getCol(state, options);
 }
 
-unsigned Computer::Log::_moveNumber = 0;
-
-unsigned Computer::getCol(const State& state, const unsigned recursionLevel)
+template <unsigned W, unsigned H>
+unsigned BasicComputer<W, H>::getCol(const State& state, const Options& options)
 {
-    Log log("computeur");
     std::cout << "COMPUTER... ";
 
     const auto timeBegin {std::chrono::high_resolution_clock::now()};
 
-    const auto col {getScores(state, state.getTurn(), recursionLevel, log, true).getBestCol()};
-
-    const std::chrono::duration<double, std::milli> duration {std::chrono::high_resolution_clock::now() - timeBegin};
-    std::cout << duration.count() << "ms\n";
-
-    return col;
-}
+    // the ponder search of the column played completes, the others abort
+    const bool pondered {isPondered(state)};
+    const unsigned ponderCol {pondered ? state.getMove(state.getMoveCount() - 1) : WIDTH};
+    stopPondering(ponderCol);
+    // the LEGACY engine scores the root columns on the pool, the cache opens
+    setup(options);
 
-Computer::Scores Computer::getScores(const State& state, const char player, const unsigned recursionLevel, Log& log, const bool multiThreading)
-{
-    if (recursionLevel == 0)
+    // the book holds one of a position and its mirror
+    Book::Entry bookEntry;
+    if (!options.bookFile.empty() && _book.open(options.bookFile, WIDTH, HEIGHT) &&
+        _book.probe(state.getBoard().getCanonicalHash(), bookEntry))
     {
-        Scores s(0);
-        log << "RECURSION LEVEL=" << recursionLevel << " SCORES=" << s << "\n";
-        return s;
+        const unsigned bookCol {state.getBoard().isMirrored() ? getMirrorCol(bookEntry.col) : bookEntry.col};
+        if (state.isColValid(bookCol))
+        {
+            const std::chrono::duration<double, std::micro> duration {std::chrono::high_resolution_clock::now() - timeBegin};
+            std::cout << duration.count() << "us BOOK DEPTH=" << _book.getHeader().recursionLevel << "\n";
+            return bookCol;
+        }
     }
 
-    log << "GET SCORES ==========================================\n";
-
+    Analysis cached;
+    if (probeCache(state, options, cached))
+    {
+        const std::chrono::duration<double, std::milli> duration {std::chrono::high_resolution_clock::now() - timeBegin};
+        std::cout << duration.count() << "ms CACHE DEPTH=" << cached.recursionLevel << "\n";
+        return cached.col;
+    }
 
-    log << "PLAYER PLAYING ========================\n";
+    if (options.engine == Engine::NEGAMAX && pondered && _ponder.done[ponderCol])
+    {
+        const std::chrono::duration<double, std::milli> duration {std::chrono::high_resolution_clock::now() - timeBegin};
+        std::cout << duration.count() << "ms PONDER DEPTH=" << _ponder.recursionLevels[ponderCol] << "\n";
+        const Scores& scores {_ponder.scores[ponderCol]};
+        const unsigned col {scores.getBestCol()};
+        addToCache(state, options, Analysis{col, scores[col], scores, 0, _ponder.recursionLevels[ponderCol]});
+        return col;
+    }
 
-    std::array<std::future<Scores::value_type>, WIDTH> scoreFutures;
-    for (unsigned col=0; col < WIDTH; ++col)
+    if (options.engine == Engine::NEGAMAX)
     {
-        const auto launch {multiThreading ? std::launch::async : std::launch::deferred};
-        scoreFutures[col] = std::async(launch, getScoreColRec, std::cref(state), col, player, recursionLevel, std::ref(log));
+        // the ponder entries are of this search
+        if (!pondered)
+        {
+            _table.newSearch();
+        }
+        Telemetry::newSearch();
+        Telemetry::setTraceEnabled(!options.traceFile.empty());
     }
+    const Telemetry::Counters countersBegin {Telemetry::getTotal()};
 
     Scores scores;
-    for (unsigned col=0; col < WIDTH; ++col)
+    unsigned recursionLevel {options.recursionLevel};
+    std::array<typename Search::Level, WIDTH * HEIGHT> levels;
+    unsigned levelCount {0};
+    if (options.engine == Engine::LEGACY)
+    {
+        scores = getScores(state, state.getTurn(), recursionLevel, options.weights, true);
+    }
+    else
     {
-        scores[col] = scoreFutures[col].get();
+        Search search(state, options.parallel == Parallel::SPLIT, 0, options.ordering, options.window, options.exactScores, options.weights);
+        Telemetry::get().trace(Telemetry::EventType::SEARCH, recursionLevel, WIDTH, 0);
+        scores = getSearchScores(search, state, options, recursionLevel);
+        levels = search.levels;
+        levelCount = search.levelCount;
     }
+    const auto col {scores.getBestCol()};
+    addToCache(state, options, Analysis{col, scores[col], scores, 0, recursionLevel});
 
-    log << "RECURSION LEVEL=" << recursionLevel << " SCORES=" << scores << "\n";
+    const std::chrono::duration<double, std::milli> duration {std::chrono::high_resolution_clock::now() - timeBegin};
+    std::cout << duration.count() << "ms";
+    if (options.engine == Engine::NEGAMAX)
+    {
+        std::cout << " DEPTH=" << recursionLevel << " " << Telemetry::getTotal() - countersBegin << " " << _table.getStats();
+        if (levelCount > 1)
+        {
+            std::cout << " LEVELS=";
+            for (unsigned index=0; index < levelCount; ++index)
+            {
+                const std::chrono::duration<double, std::milli> levelDuration {levels[index].time};
+                std::cout << levels[index].recursionLevel << ":" << levelDuration.count() << "ms" << (index + 1 == levelCount ? "" : ",");
+            }
+        }
 
-    return scores;
+        if (!options.traceFile.empty())
+        {
+            Telemetry::setTraceEnabled(false);
+            std::ofstream traceFile(options.traceFile + "_" + std::to_string(state.getMoveCount()) + ".json");
+            Telemetry::writeJson(traceFile);
+        }
+    }
+    std::cout << "\n";
+
+    return col;
 }
 
-int Computer::getScoreColRec(const State& state, const unsigned col, const char player, const unsigned recursionLevel, Log& log)
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::setup(const Options& options)
 {
-    if (!state.isColValid(col))
+    _table.resize(options.tableSize, options.replacement);
+    _pool.resize(options.threads);
+    // the helper searches of lazy SMP, from the calling thread
+    Arena::get().reserve((_pool.getThreadCount() - 1) * sizeof(Search));
+    _cache.setFile(options.cacheFile, WIDTH, HEIGHT);
+    _tablebase.setFile(options.tablebaseFile, WIDTH, HEIGHT);
+}
+
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Analysis BasicComputer<W, H>::analyse(const State& state, const Options& options)
+{
+    Analysis cached;
+    if (probeCache(state, options, cached))
     {
-        return Scores::INVALID_MOVE;
+        return cached;
     }
 
-    State nextState {state};
-    nextState.addPosition(col);
+    Telemetry::ThreadTelemetry& telemetry {Telemetry::get()};
+    const uint64_t nodesBegin {telemetry.nodes.get()};
 
-    const auto scoreCol {getScoreCol(nextState, col, log)};
-    if (scoreCol == Scores::WIN_MOVE ||
-        scoreCol == Scores::DOUBLE_TRAP_MOVE ||
-        scoreCol == Scores::FORCED_MOVE)
+    Search search(state, false, 0, options.ordering, options.window, options.exactScores, options.weights);
+    Scores scores;
+    unsigned recursionLevel {options.recursionLevel};
+    if (options.moveTime.count() > 0)
     {
-        log << "RECURSION LEVEL=" << recursionLevel << " COL=" << col << " SCORE=" << scoreCol << "\n";
-        return scoreCol;
+        scores = getIterativeScores(search, state, Clock::now() + options.moveTime, WIDTH * HEIGHT, recursionLevel);
     }
-
-    Scores recScores {getScores(nextState, player, recursionLevel - 1, log)};
-    log << "RECURSION LEVEL=" << recursionLevel << " COL=" << col << " MAX=" << recScores.max() << "\n";
-
-    Scores::value_type bestRecScore {recScores.max()};
-    if (player == nextState.getLastPayer())
+    else if (options.window >= Window::ASPIRATION)
     {
-        bestRecScore = -bestRecScore;
+        scores = getDeepeningScores(search, state, options.recursionLevel);
+    }
+    else
+    {
+        scores = getWindowScores(search, state, options.recursionLevel, Scores(0));
     }
 
-    const Scores::value_type bestRecScoreWithFactor {static_cast<Scores::value_type>(static_cast<double>(bestRecScore) / 1.5)}; // recursion factor
-    log << "RECURSION LEVEL=" << recursionLevel << " COL=" << col << " SCORE=" << bestRecScoreWithFactor << "\n";
-    return bestRecScoreWithFactor;
+    const unsigned col {scores.getBestCol()};
+    const Analysis analysis {col, scores[col], scores, telemetry.nodes.get() - nodesBegin, recursionLevel};
+    addToCache(state, options, analysis);
+    return analysis;
 }
 
-Computer::Scores::value_type Computer::getScoreCol(const State& state, unsigned const col, Log& log)
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::startPondering(const State& state, const Options& options)
 {
-    if (state.isDone()) // check if winning move
+    stopPondering(WIDTH);
+    if (state.isDone())
     {
-        log << "COL=" << col << " WIN_MOVE\n";
-        return Scores::WIN_MOVE;
+        return;
     }
 
-    // EVALUATION
-    log << "COL=" << col << " EVALUATION - opponent\n";
-    Scores::value_type score {0};
-    const Board& board {state.getBoard()};
-    const char player {getOpponent(state.getTurn())}; // get last played
-    const Board opponentEvaluationBoard {getEvaluationBoard(board, getOpponent(player), log)};
-    for (unsigned evalCol=0; evalCol < WIDTH; ++evalCol)
+    setup(options);
+    _table.newSearch();
+
+    _ponder.key = state.getBoard().getHash();
+    _ponder.moveCount = state.getMoveCount();
+    _ponder.options = options;
+    _ponder.stopped = false;
+    _ponder.col = WIDTH;
+    _ponder.search = nullptr;
+    _ponder.done.fill(false);
+    _ponder.thread = std::thread(ponder, state);
+}
+
+// WIDTH aborts every column
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::stopPondering(const unsigned col)
+{
     {
-        if (board.isColValid(evalCol))
+        std::lock_guard<std::mutex> lock(_ponder.mutex);
+        _ponder.stopped = true;
+        if (_ponder.search != nullptr && _ponder.col != col)
         {
-            // future win for opponent: don't play
-            const char opponentEvalCol {opponentEvaluationBoard[board.getTopRow(evalCol)][evalCol]};
-            if (opponentEvalCol == 'F' || opponentEvalCol == 'D')
-            {
-                log << "COL=" << col << " EVALUATION - opponent EVALCOL=" << evalCol << " FORCED_MOVE\n";
-                return Scores::FORCED_MOVE;
-            }
+            _ponder.search->abort();
         }
     }
+    if (_ponder.thread.joinable())
+    {
+        _ponder.thread.join();
+    }
+}
 
-    log << "COL=" << col << " EVALUATION - player\n";
-    const Board evaluationBoard {getEvaluationBoard(board, player, log)};
+template <unsigned W, unsigned H>
+BasicComputer<W, H>::Ponder::Ponder() : key(~uint64_t{0}), moveCount(0), stopped(true), col(WIDTH), search(nullptr), done{}
+{}
+
+template <unsigned W, unsigned H>
+BasicComputer<W, H>::Ponder::~Ponder()
+{
+    stopPondering(WIDTH);
+}
 
-    unsigned forceMoveCount = 0;
-    for (unsigned evalCol=0; evalCol < WIDTH; ++evalCol)
+// The ponder thread, until every column is searched or it is stopped. In
+// a symmetric position a column gets the mirrored scores of its mirror.
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::ponder(const State& state)
+{
+    const bool symmetric {state.getBoard().isSymmetric()};
+    for (const unsigned col : getBaseColOrder(Ordering::CENTER))
     {
-        if (board.isColValid(evalCol))
+        if (!state.isColValid(col))
+        {
+            continue;
+        }
+        State colState {state};
+        colState.addPosition(col);
+        if (colState.isDone())
         {
-            const char playerEvalCol {evaluationBoard[board.getTopRow(evalCol)][evalCol]};
-            if (playerEvalCol == 'D')
+            continue;
+        }
+
+        const unsigned mirrorCol {getMirrorCol(col)};
+        if (symmetric && _ponder.done[mirrorCol])
+        {
+            std::lock_guard<std::mutex> lock(_ponder.mutex);
+            for (unsigned scoreCol=0; scoreCol < WIDTH; ++scoreCol)
             {
-                score = std::max(score, Scores::DOUBLE_TRAP_MOVE);
-                log << "COL=" << col << " EVALUATION - opponent EVALCOL=" << evalCol << " DOUBLE_TRAP_MOVE\n";
+                _ponder.scores[col][scoreCol] = _ponder.scores[mirrorCol][getMirrorCol(scoreCol)];
             }
-            else if (playerEvalCol == 'F')
+            _ponder.recursionLevels[col] = _ponder.recursionLevels[mirrorCol];
+            _ponder.done[col] = true;
+            continue;
+        }
+
+        const Options& options {_ponder.options};
+        Search search(colState, options.parallel == Parallel::SPLIT, 0, options.ordering, options.window, options.exactScores, options.weights);
+        {
+            std::lock_guard<std::mutex> lock(_ponder.mutex);
+            if (_ponder.stopped)
             {
-                score = std::max(score, Scores::TRAP_MOVE);
-                ++forceMoveCount;
-                log << "COL=" << col << " EVALUATION - opponent EVALCOL=" << evalCol << " TRAP_MOVE\n";
+                return;
             }
+            _ponder.col = col;
+            _ponder.search = &search;
         }
-    }
 
-    // seven // double lines // 3 in a row
-    // --> 2 forced moves in same col
-    // --> 2 forced moves in the same board
-    if (forceMoveCount > 1)
-    {
-        score = Scores::DOUBLE_TRAP_MOVE;
-        log << "COL=" << col << " EVALUATION - opponent DOUBLE_TRAP_MOVE forceMoveCount > 1\n";
-    }
+        unsigned recursionLevel;
+        const Scores scores {getSearchScores(search, colState, options, recursionLevel)};
 
-    return score;
+        std::lock_guard<std::mutex> lock(_ponder.mutex);
+        _ponder.col = WIDTH;
+        _ponder.search = nullptr;
+        // a timed search aborts at its deadline, with the scores of its last level
+        if (!search.isAborted() || options.moveTime.count() > 0)
+        {
+            _ponder.scores[col] = scores;
+            _ponder.recursionLevels[col] = recursionLevel;
+            _ponder.done[col] = true;
+        }
+    }
 }
 
-Board Computer::getEvaluationBoard(const Board& board, const char player, Log& log)
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::startSearch(const State& state, const Options& options, const std::function<void(const Analysis&)>& done)
 {
-    Board evaluationBoard {board};
-
-    horizontalEvaluation(board, player, evaluationBoard);
-    verticalEvaluation(board, player, evaluationBoard);
-    diagonalEvaluation(board, player, evaluationBoard);
-    doubleForceMoveEvaluation(board, player, evaluationBoard);
+    stopSearch();
+    stopPondering(WIDTH);
 
-    log << evaluationBoard;
+    setup(options);
+    _table.newSearch();
+    Telemetry::newSearch();
 
-    return evaluationBoard;
+    _background.options = options;
+    _background.done = done;
+    _background.stopped = false;
+    _background.search = nullptr;
+    _background.thread = std::thread(searchBackground, state);
 }
 
-void Computer::horizontalEvaluation(const Board& board, const char player, Board& evaluationBoard)
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::stopSearch()
 {
-    for (unsigned col=0; col < WIDTH - 3; ++col)
     {
-        for (int row = HEIGHT - 1; row >= 0; --row)
+        std::lock_guard<std::mutex> lock(_background.mutex);
+        _background.stopped = true;
+        if (_background.search != nullptr)
         {
-            if (board[row][col] == player)
-            {
-                // XXX- XX-X
-                if (board[row][col + 1] == player)
-                {
-                    // XXX-
-                    if (board[row][col + 2] == player &&
-                        board[row][col + 3] == EMPTY)
-                    {
-                        evaluationBoard[row][col + 3] = 'F';
-                    }
-                    // XX-X
-                    else if (board[row][col + 2] == EMPTY &&
-                                board[row][col + 3] == player)
-                    {
-                        evaluationBoard[row][col + 2] = 'F';
-                    }
-                }
-                // X-XX
-                else if (board[row][col + 1] == EMPTY  &&
-                            board[row][col + 2] == player &&
-                            board[row][col + 3] == player)
-                {
-                    evaluationBoard[row][col + 1] = 'F';
-                }
-            }
-            // -XXX
-            else if(board[row][col    ] == EMPTY &&
-                    board[row][col + 1] == player &&
-                    board[row][col + 2] == player &&
-                    board[row][col + 3] == player)
-            {
-                evaluationBoard[row][col] = 'F';
-            }
+            _background.search->abort();
         }
     }
+    if (_background.thread.joinable())
+    {
+        _background.thread.join();
+    }
 }
 
-void Computer::verticalEvaluation(const Board& board, const char player, Board& evaluationBoard)
+template <unsigned W, unsigned H>
+BasicComputer<W, H>::Background::Background() : stopped(true), search(nullptr)
+{}
+
+template <unsigned W, unsigned H>
+BasicComputer<W, H>::Background::~Background()
 {
-    for (unsigned col=0; col < WIDTH; ++col)
+    stopSearch();
+}
+
+// the startSearch thread, every node checks whether stopSearch aborted it
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::searchBackground(const State& state)
+{
+    const Options& options {_background.options};
+    const Telemetry::Counters countersBegin {Telemetry::getTotal()};
+    Search search(state, options.parallel == Parallel::SPLIT, 0, options.ordering, options.window, options.exactScores, options.weights);
     {
-        for (unsigned row = HEIGHT - 1; row >= 3; --row)
+        std::lock_guard<std::mutex> lock(_background.mutex);
+        if (_background.stopped)
         {
-            // -
-            // X
-            // X
-            // X
-            if (board[row    ][col] == EMPTY  &&
-                board[row - 1][col] == player &&
-                board[row - 2][col] == player &&
-                board[row - 3][col] == player)
-            {
-                evaluationBoard[row][col] = 'F';
-            }
+            search.abort();
         }
+        _background.search = &search;
+    }
+
+    const bool timed {options.moveTime.count() > 0};
+    unsigned recursionLevel;
+    Scores scores {getIterativeScores(search, state, timed ? Clock::now() + options.moveTime : Clock::time_point::max(),
+                                      timed ? WIDTH * HEIGHT : options.recursionLevel, recursionLevel)};
+    {
+        std::lock_guard<std::mutex> lock(_background.mutex);
+        _background.search = nullptr;
+    }
+
+    // stopped within the first level, a few evaluations
+    if (recursionLevel == 0)
+    {
+        scores = getScores(state, state.getTurn(), 1, options.weights);
+        recursionLevel = 1;
+    }
+
+    const unsigned col {scores.getBestCol()};
+    _background.done(Analysis{col, scores[col], scores, (Telemetry::getTotal() - countersBegin).nodes, recursionLevel});
+}
+
+// state follows the last pondered position by one column
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::isPondered(const State& state)
+{
+    if (_ponder.moveCount + 1 != state.getMoveCount())
+    {
+        return false;
     }
+    State previousState {state};
+    previousState.undoPosition();
+    return previousState.getBoard().getHash() == _ponder.key;
 }
 
-void Computer::diagonalEvaluation(const Board& board, const char player, Board& evaluationBoard)
+// the NEGAMAX scores of getCol, the recursion level reached in recursionLevel
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Scores BasicComputer<W, H>::getSearchScores(Search& search, const State& state, const Options& options, unsigned& recursionLevel)
 {
-    for (unsigned col=WIDTH-1; col >= 3; --col)
+    recursionLevel = options.recursionLevel;
+    if (options.moveTime.count() > 0)
     {
-        for (unsigned row=HEIGHT-1; row >= 3; --row)
+        return getIterativeScores(search, state, Clock::now() + options.moveTime, WIDTH * HEIGHT, recursionLevel);
+    }
+    else if (search.window >= Window::ASPIRATION)
+    {
+        return getDeepeningScores(search, state, recursionLevel);
+    }
+    else if (!search.split)
+    {
+        return getLazySmpScores(search, state, recursionLevel, Scores(0));
+    }
+    return getWindowScores(search, state, recursionLevel, Scores(0));
+}
+
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Scores BasicComputer<W, H>::getScores(const State& state, const char player, const unsigned recursionLevel, const Weights& weights, const bool multiThreading)
+{
+    if (recursionLevel == 0)
+    {
+        return Scores(0);
+    }
+
+    // a column of a symmetric position scores as its mirror
+    const bool symmetric {state.getBoard().isSymmetric()};
+    Scores scores;
+    ThreadPool::Group group;
+    for (unsigned col=0; col < WIDTH; ++col)
+    {
+        if (symmetric && getMirrorCol(col) < col)
         {
-            //    X    X    X
-            //   X?   X?   -?
-            //  X??  -??  X??
-            // -??? X??? X???
-            if (board[row][col] == player)
-            {
-                //    X    X
-                //   X?   X?
-                //  X??  -??
-                // -??? X???
-                if (board[row - 1][col - 1] == player)
-                {
-                    //    X
-                    //   X?
-                    //  X??
-                    // -???
-                    if (board[row - 2][col - 2] == player &&
-                        board[row - 3][col - 3] == EMPTY)
-                    {
-                        evaluationBoard[row - 3][col - 3] = 'F';
-                    }
-                    //    X
-                    //   X?
-                    //  -??
-                    // X???
-                    else if (board[row - 2][col - 2] == EMPTY &&
-                                board[row - 3][col - 3] == player)
-                    {
-                        evaluationBoard[row - 2][col - 2] = 'F';
-                    }
-                }
-                //    X
-                //   -?
-                //  X??
-                // X???
-                else if (board[row - 1][col - 1] == EMPTY &&
-                            board[row - 2][col - 2] == player &&
-                            board[row - 3][col - 3] == player)
-                {
-                    evaluationBoard[row - 1][col - 1] = 'F';
-                }
-            }
-            //    -
-            //   X?
-            //  X??
-            // X???
-            else if (board[row    ][col    ] == EMPTY &&
-                        board[row - 1][col - 1] == player &&
-                        board[row - 2][col - 2] == player &&
-                        board[row - 3][col - 3] == player)
+            continue;
+        }
+        if (multiThreading)
+        {
+            _pool.submit(group, [&state, &scores, &weights, col, player, recursionLevel]
             {
-                evaluationBoard[row][col] = 'F';
-            }
+                scores[col] = getScoreColRec(state, col, player, recursionLevel, weights);
+            });
+        }
+        else
+        {
+            scores[col] = getScoreColRec(state, col, player, recursionLevel, weights);
         }
     }
+    _pool.wait(group);
 
-    for (unsigned col=0; col < WIDTH - 3; ++col)
+    if (symmetric)
     {
-        for (unsigned row=HEIGHT-1; row >= 3; --row)
+        for (unsigned col=(WIDTH + 1) / 2; col < WIDTH; ++col)
         {
-            // X    X    X
-            // ?X   ?X   ?-
-            // ??X  ??-  ??X
-            // ???- ???X ???X
-            if (board[row][col] == player)
-            {
-                // X    X
-                // ?X   ?X
-                // ??X  ??-
-                // ???- ???X
-                if (board[row - 1][col + 1] == player)
-                {
-                    // X
-                    // ?X
-                    // ??X
-                    // ???-
-                    if (board[row - 2][col + 2] == player &&
-                        board[row - 3][col + 3] == EMPTY)
-                    {
-                        evaluationBoard[row - 3][col + 3] = 'F';
-                    }
-                    // X
-                    // ?X
-                    // ??-
-                    // ???X
-                    else if (board[row - 2][col + 2] == EMPTY &&
-                                board[row - 3][col + 3] == player)
-                    {
-                        evaluationBoard[row - 2][col + 2] = 'F';
-                    }
-                }
-                // X
-                // ?-
-                // ??X
-                // ???X
-                else if (board[row - 1][col + 1] == EMPTY &&
-                        board[row - 2][col + 2] == player &&
-                        board[row - 3][col + 3] == player)
-                {
-                    evaluationBoard[row - 1][col + 1] = 'F';
-                }
-            }
-            // -
-            // ?X
-            // ??X
-            // ???X
-            else if (board[row    ][col    ] == EMPTY &&
-                        board[row - 1][col + 1] == player &&
-                        board[row - 2][col + 2] == player &&
-                        board[row - 3][col + 3] == player)
-            {
-                evaluationBoard[row][col] = 'F';
-            }
+            scores[col] = scores[getMirrorCol(col)];
         }
     }
+
+    return scores;
 }
 
-void Computer::doubleForceMoveEvaluation(const Board& board, const char player, Board& evaluationBoard)
+template <unsigned W, unsigned H>
+int BasicComputer<W, H>::getScoreColRec(const State& state, const unsigned col, const char player, const unsigned recursionLevel, const Weights& weights)
 {
-    for (unsigned col=0; col < WIDTH; ++col)
+    if (!state.isColValid(col))
+    {
+        return Scores::INVALID_MOVE;
+    }
+
+    State nextState {state};
+    nextState.addPosition(col);
+
+    Score scoreCol;
+    if (getFinalScoreCol(nextState, weights, scoreCol))
+    {
+        return scoreCol;
+    }
+
+    Scores recScores {getScores(nextState, player, recursionLevel - 1, weights)};
+
+    Score bestRecScore {recScores.max()};
+    if (player == nextState.getLastPayer())
+    {
+        bestRecScore = -bestRecScore;
+    }
+
+    return getRecursionScore(bestRecScore, weights);
+}
+
+template <unsigned W, unsigned H>
+BasicComputer<W, H>::Search::Search(const State& state, const bool split, const unsigned rotation, const Ordering ordering,
+                         const Window window, const bool exactScores, const Weights& weights) :
+    player(state.getTurn()), moveCount(state.getMoveCount()), split(split), rotation(rotation), ordering(ordering),
+    window(window), exactScores(exactScores), weights(weights), tableTag(getTableTag(weights)), levelCount(0), _timed(false), _aborted(false)
+{
+    for (auto& killers : _killers)
     {
-        for (unsigned row = HEIGHT - 1; row >= 1; --row)
+        for (std::atomic<uint8_t>& killer : killers)
         {
-            if (evaluationBoard[row    ][col] == 'F' &&
-                evaluationBoard[row - 1][col] == 'F')
-            {
-                evaluationBoard[row - 1][col] = 'D';
-            }
+            killer.store(WIDTH, std::memory_order_relaxed);
         }
     }
+    for (std::atomic<uint32_t>& history : _history)
+    {
+        history.store(0, std::memory_order_relaxed);
+    }
 }
 
+// set between two recursion levels, while no pool thread searches
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::Search::setDeadline(const Clock::time_point deadline)
+{
+    _timed = true;
+    _deadline = deadline;
+}
+
+// the clock is only read every CLOCK_CHECK_NODES nodes of a thread
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::Search::addNode(const State& state)
+{
+    Telemetry::ThreadTelemetry& telemetry {Telemetry::get()};
+    telemetry.nodes.add();
+    telemetry.maxPly.setMax(state.getMoveCount() - moveCount);
+    if (_timed && telemetry.nodes.get() % CLOCK_CHECK_NODES == 0 && Clock::now() >= _deadline && !isAborted())
+    {
+        _aborted.store(true, std::memory_order_relaxed);
+        telemetry.trace(Telemetry::EventType::ABORT, 0, WIDTH, 0);
+    }
+}
+
+// col failed high in state, at recursionLevel
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::Search::addCutoff(const State& state, const unsigned col, const unsigned recursionLevel, const bool first)
+{
+    Telemetry::ThreadTelemetry& telemetry {Telemetry::get()};
+    telemetry.cutoffs.add();
+    if (first)
+    {
+        telemetry.firstCutoffs.add();
+    }
+
+    auto& killers {_killers[state.getMoveCount()]};
+    if (killers[0].load(std::memory_order_relaxed) != col)
+    {
+        for (unsigned index=KILLER_COUNT - 1; index > 0; --index)
+        {
+            killers[index].store(killers[index - 1].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        killers[0].store(static_cast<uint8_t>(col), std::memory_order_relaxed);
+    }
+
+    // deep cutoffs prune more, they weigh more
+    _history[getHistoryIndex(state, col)].fetch_add(recursionLevel * recursionLevel, std::memory_order_relaxed);
+}
+
+// WIDTH when there is no such killer
+template <unsigned W, unsigned H>
+unsigned BasicComputer<W, H>::Search::getKiller(const State& state, const unsigned index) const
+{
+    return _killers[state.getMoveCount()][index].load(std::memory_order_relaxed);
+}
+
+template <unsigned W, unsigned H>
+uint32_t BasicComputer<W, H>::Search::getHistory(const State& state, const unsigned col) const
+{
+    return _history[getHistoryIndex(state, col)].load(std::memory_order_relaxed);
+}
+
+// the cell col plays in, for the root player or the opponent
+template <unsigned W, unsigned H>
+unsigned BasicComputer<W, H>::Search::getHistoryIndex(const State& state, const unsigned col) const
+{
+    const unsigned side {player == state.getTurn() ? 0u : 1u};
+    return (side * HEIGHT + state.getBoard().getTopRow(col)) * WIDTH + col;
+}
+
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::Search::abort()
+{
+    _aborted.store(true, std::memory_order_relaxed);
+}
+
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::Search::isAborted() const
+{
+    return _aborted.load(std::memory_order_relaxed);
+}
+
+template <unsigned W, unsigned H>
+BasicComputer<W, H>::SplitPoint::SplitPoint(const SplitPoint* parent, const Score alpha, const Score beta,
+                                 const Score best, const unsigned bestCol) :
+    parent(parent), beta(beta), cutoff(false), alpha(alpha), best(best), bestCol(bestCol)
+{}
+
+// a column failed high here or at an ancestor split point
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::SplitPoint::isCutoff() const
+{
+    for (const SplitPoint* splitPoint {this}; splitPoint != nullptr; splitPoint = splitPoint->parent)
+    {
+        if (splitPoint->cutoff.load(std::memory_order_relaxed))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Score BasicComputer<W, H>::SplitPoint::getAlpha()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return alpha;
+}
+
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::SplitPoint::update(const unsigned col, const Score score)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (score > best)
+    {
+        best = score;
+        bestCol = col;
+    }
+    alpha = std::max(alpha, best);
+    if (best >= beta)
+    {
+        cutoff.store(true, std::memory_order_relaxed);
+    }
+}
+
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::isAborted(const Search& search, const SplitPoint* splitPoint)
+{
+    return search.isAborted() || (splitPoint != nullptr && splitPoint->isCutoff());
+}
+
+// columns from the center out from Ordering::CENTER up, in order otherwise
+template <unsigned W, unsigned H>
+std::array<unsigned, BasicComputer<W, H>::WIDTH> BasicComputer<W, H>::getBaseColOrder(const Ordering ordering)
+{
+    std::array<unsigned, WIDTH> cols;
+    for (unsigned index=0; index < WIDTH; ++index)
+    {
+        const unsigned offset {(index + 1) / 2};
+        cols[index] = ordering == Ordering::NONE ? index :
+                      index % 2 == 1             ? WIDTH / 2 - offset :
+                                                   WIDTH / 2 + offset;
+    }
+    return cols;
+}
+
+// WIDTH stays WIDTH
+template <unsigned W, unsigned H>
+unsigned BasicComputer<W, H>::getMirrorCol(const unsigned col)
+{
+    return col < WIDTH ? WIDTH - 1 - col : col;
+}
+
+// stable insertion sort, std::stable_sort takes a buffer from the heap
+template <unsigned W, unsigned H>
+template <typename Compare>
+void BasicComputer<W, H>::sortCols(unsigned* begin, unsigned* end, const Compare& compare)
+{
+    for (unsigned* next {begin}; next != end; ++next)
+    {
+        const unsigned col {*next};
+        unsigned* slot {next};
+        for (; slot != begin && compare(col, *(slot - 1)); --slot)
+        {
+            *slot = *(slot - 1);
+        }
+        *slot = col;
+    }
+}
+
+// Fills cols with the valid columns of state in search order and returns
+// their count. tableCol is WIDTH when the table has no column. A symmetric
+// position only gets one of two mirrored columns, they score the same.
+template <unsigned W, unsigned H>
+unsigned BasicComputer<W, H>::getColOrder(const Search& search, const State& state, const unsigned tableCol, std::array<unsigned, WIDTH>& cols)
+{
+    const bool symmetric {state.getBoard().isSymmetric()};
+    unsigned colCount {0};
+    const auto addCol = [&state, &cols, &colCount, symmetric](const unsigned col)
+    {
+        const auto end {std::begin(cols) + colCount};
+        if (col < WIDTH && state.isColValid(col) && std::find(std::begin(cols), end, col) == end &&
+            (!symmetric || std::find(std::begin(cols), end, getMirrorCol(col)) == end))
+        {
+            cols[colCount++] = col;
+        }
+    };
+
+    if (search.ordering >= Ordering::TABLE)
+    {
+        addCol(tableCol);
+    }
+    if (search.ordering >= Ordering::KILLERS)
+    {
+        for (unsigned index=0; index < Search::KILLER_COUNT; ++index)
+        {
+            addCol(search.getKiller(state, index));
+        }
+    }
+
+    const unsigned sortBegin {colCount};
+    for (const unsigned col : getBaseColOrder(search.ordering))
+    {
+        addCol(col);
+    }
+    if (search.ordering >= Ordering::HISTORY)
+    {
+        sortCols(std::begin(cols) + sortBegin, std::begin(cols) + colCount, [&search, &state](unsigned lhs, unsigned rhs)
+        {
+            return search.getHistory(state, lhs) > search.getHistory(state, rhs);
+        });
+    }
+
+    return colCount;
+}
+
+// Deepens one recursion level at a time until deadline, and returns the
+// scores of the last completed level in recursionLevel. The first level
+// always completes. Each level searches first the columns the previous one
+// scored best, and finds the table columns of the previous levels below
+// the root.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Scores BasicComputer<W, H>::getIterativeScores(Search& search, const State& state, const Clock::time_point deadline, const unsigned maxRecursionLevel, unsigned& recursionLevel)
+{
+    const auto timeBegin {Clock::now()};
+
+    Scores scores(0);
+    recursionLevel = 0;
+    while (recursionLevel < maxRecursionLevel)
+    {
+        const Scores levelScores {search.split ?
+            getWindowScores(search, state, recursionLevel + 1, scores) :
+            getLazySmpScores(search, state, recursionLevel + 1, scores)};
+        if (search.isAborted())
+        {
+            break;
+        }
+
+        scores = levelScores;
+        ++recursionLevel;
+        search.setDeadline(deadline);
+        Telemetry::get().trace(Telemetry::EventType::LEVEL, recursionLevel, scores.getBestCol(), scores.max());
+
+        // a winning column wins at every level
+        if (scores.max() == Scores::WIN_MOVE)
+        {
+            break;
+        }
+
+        // the next level costs more than the time spent so far, don't start what can't finish
+        if (Clock::now() - timeBegin > (deadline - timeBegin) / 2)
+        {
+            break;
+        }
+    }
+
+    return scores;
+}
+
+// Searches the levels up to recursionLevel one after the other, for the
+// windows of ASPIRATION and MTDF centered on the previous level.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Scores BasicComputer<W, H>::getDeepeningScores(Search& search, const State& state, const unsigned recursionLevel)
+{
+    Scores scores(0);
+    for (unsigned level=1; level <= recursionLevel && !search.isAborted(); ++level)
+    {
+        scores = search.split ?
+            getWindowScores(search, state, level, scores) :
+            getLazySmpScores(search, state, level, scores);
+    }
+    return scores;
+}
+
+// One level of the root, through the window driver of search.window.
+// ASPIRATION searches a window around the previous best score, widened past
+// the best score on the side that failed until it falls inside. MTDF
+// closes in on the best score with null windows, then finds the columns
+// tying with it. Ties with the best score end exact either way, and the
+// first level and exactScores search the full window.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Scores BasicComputer<W, H>::getWindowScores(Search& search, const State& state, const unsigned recursionLevel, const Scores& previousScores)
+{
+    const auto timeBegin {Clock::now()};
+
+    Scores scores;
+    if (search.window < Window::ASPIRATION || search.exactScores || recursionLevel == 1)
+    {
+        scores = getNegamaxScores(search, state, recursionLevel, previousScores, -Scores::INFINITE, Scores::INFINITE);
+    }
+    else if (search.window == Window::ASPIRATION)
+    {
+        Score delta {Scores::ASPIRATION};
+        Score alpha {std::max(previousScores.max() - delta, -Scores::INFINITE)};
+        Score beta {std::min(previousScores.max() + delta, Scores::INFINITE)};
+        while (true)
+        {
+            scores = getNegamaxScores(search, state, recursionLevel, previousScores, alpha, beta);
+            const Score best {scores.max()};
+            if (search.isAborted() || (best > alpha && best < beta))
+            {
+                break;
+            }
+
+            delta *= 4;
+            if (best <= alpha)
+            {
+                alpha = std::max(best - delta, -Scores::INFINITE);
+            }
+            else
+            {
+                beta = std::min(best + delta, Scores::INFINITE);
+            }
+        }
+    }
+    else
+    {
+        Score lower {-Scores::INFINITE};
+        Score upper {Scores::INFINITE};
+        Score best {previousScores.max()};
+        while (lower < upper && !search.isAborted())
+        {
+            const Score beta {best == lower ? best + 1 : best};
+            best = getNegamaxScores(search, state, recursionLevel, previousScores, beta - 1, beta).max();
+            (best < beta ? upper : lower) = best;
+        }
+        // the null windows leave the columns tying best bounds
+        scores = getNegamaxScores(search, state, recursionLevel, previousScores, best - 1, best + 1);
+    }
+
+    if (!search.isAborted() && search.levelCount < search.levels.size())
+    {
+        search.levels[search.levelCount++] = typename Search::Level{recursionLevel, Clock::now() - timeBegin};
+    }
+
+    return scores;
+}
+
+// Same tree as getScores/getScoreColRec, searched with alpha-beta windows.
+// The root keeps every column that can still reach the best score exact,
+// so getBestCol breaks ties exactly as the legacy engine does; with
+// Search::exactScores every column is exact. A best score outside of the
+// root window (alpha, beta) is only a bound, and once a column reaches
+// beta the columns not started are left out. Columns are searched by
+// decreasing previousScores, which only changes the node count.
+// The first column is searched alone, the others in parallel on the pool.
+// A symmetric root only searches its left half and center column, the
+// right half gets the scores of its mirror.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Scores BasicComputer<W, H>::getNegamaxScores(Search& search, const State& state, const unsigned recursionLevel, const Scores& previousScores,
+                                                                           const Score alpha, const Score beta)
+{
+    if (recursionLevel == 0)
+    {
+        return Scores(0);
+    }
+
+    const std::array<unsigned, WIDTH> baseCols {getBaseColOrder(search.ordering)};
+    std::array<unsigned, WIDTH> cols;
+    for (unsigned index=0; index < WIDTH; ++index)
+    {
+        cols[index] = baseCols[(index + search.rotation) % WIDTH];
+    }
+    sortCols(std::begin(cols), std::end(cols), [&previousScores](unsigned lhs, unsigned rhs)
+    {
+        return previousScores[lhs] > previousScores[rhs];
+    });
+
+    Scores scores;
+    SplitPoint root(nullptr, alpha, beta, Scores::INVALID_MOVE, WIDTH);
+    const auto searchCol = [&search, &state, &scores, &root, recursionLevel, beta](const unsigned col, const bool first)
+    {
+        if (root.isCutoff())
+        {
+            return;
+        }
+
+        // ties with the best score must stay exact
+        const Score colAlpha {search.exactScores ? -Scores::INFINITE : root.getAlpha()};
+        State colState {state};
+        const Score score {(first ? getNegamaxScoreCol : getPvsScoreCol)(search, colState, col, recursionLevel,
+                                                                         colAlpha == -Scores::INFINITE ? colAlpha : colAlpha - 1,
+                                                                         beta, nullptr)};
+        scores[col] = score;
+        root.update(col, score);
+        Telemetry::get().trace(Telemetry::EventType::ROOT, recursionLevel, col, score);
+    };
+
+    const bool symmetric {state.getBoard().isSymmetric()};
+    ThreadPool::Group group;
+    bool first {true};
+    for (const unsigned col : cols)
+    {
+        if (!state.isColValid(col) || (symmetric && getMirrorCol(col) < col))
+        {
+            continue;
+        }
+
+        if (first || !search.split || _pool.getThreadCount() == 1)
+        {
+            searchCol(col, first);
+            first = false;
+        }
+        else
+        {
+            _pool.submit(group, [&searchCol, col] { searchCol(col, false); });
+        }
+    }
+    _pool.wait(group);
+
+    if (symmetric)
+    {
+        for (unsigned col=(WIDTH + 1) / 2; col < WIDTH; ++col)
+        {
+            scores[col] = scores[getMirrorCol(col)];
+        }
+    }
+
+    return scores;
+}
+
+// Lazy SMP: every pool thread but the caller searches the root alone, one
+// level deeper for every other helper and with a rotated column order, and
+// fills the shared table the caller searches with. The table only cuts on
+// results of the same recursionLevel, which are the same whoever computed
+// them: the scores match a search on one thread.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Scores BasicComputer<W, H>::getLazySmpScores(Search& search, const State& state, const unsigned recursionLevel, const Scores& previousScores)
+{
+    const unsigned helperCount {_pool.getThreadCount() - 1};
+    Arena& arena {Arena::get()};
+    arena.reserve(helperCount * sizeof(Search));
+    const Arena::Scope scope(arena);
+
+    ThreadPool::Group group;
+    Search* helperSearches {nullptr};
+    for (unsigned helper=1; helper <= helperCount; ++helper)
+    {
+        Search& helperSearch {arena.create<Search>(state, false, helper, search.ordering, search.window, search.exactScores, search.weights)};
+        if (helper == 1)
+        {
+            helperSearches = &helperSearch;
+        }
+        const unsigned helperRecursionLevel {recursionLevel + helper % 2};
+        _pool.submit(group, [&helperSearch, &state, &previousScores, helperRecursionLevel]
+        {
+            getNegamaxScores(helperSearch, state, helperRecursionLevel, previousScores, -Scores::INFINITE, Scores::INFINITE);
+        });
+    }
+
+    const Scores scores {getWindowScores(search, state, recursionLevel, previousScores)};
+
+    for (unsigned index=0; index < helperCount; ++index)
+    {
+        helperSearches[index].abort();
+    }
+    _pool.wait(group);
+
+    return scores;
+}
+
+// Fail-soft alpha-beta on getScores(state, player, recursionLevel).max().
+// Table scores only cut at the same recursionLevel, deeper results differ
+// from the legacy scores; their best column is searched first.
+// Young brothers wait: from SplitPoint::MIN_RECURSION_LEVEL up, the columns
+// after the first one are searched in parallel, a cutoff stops the others.
+// An aborted search returns a meaningless score and stores nothing.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Score BasicComputer<W, H>::negamax(Search& search, State& state, const unsigned recursionLevel, Score alpha, Score beta, const SplitPoint* splitPoint)
+{
+    if (recursionLevel == 0)
+    {
+        return 0;
+    }
+
+    search.addNode(state);
+    if (isAborted(search, splitPoint))
+    {
+        return 0;
+    }
+
+    bool mirrored;
+    const uint64_t key {getTableKey(search, state, mirrored)};
+    unsigned tableCol {WIDTH};
+    TranspositionTable::Entry entry;
+    if (_table.probe(key, entry) && entry.bound != TranspositionTable::Bound::FINAL)
+    {
+        tableCol = mirrored ? getMirrorCol(entry.bestCol) : entry.bestCol;
+        if (entry.depth == recursionLevel)
+        {
+            if (entry.bound == TranspositionTable::Bound::EXACT ||
+                (entry.bound == TranspositionTable::Bound::LOWER && entry.score >= beta) ||
+                (entry.bound == TranspositionTable::Bound::UPPER && entry.score <= alpha))
+            {
+                return entry.score;
+            }
+        }
+    }
+
+    std::array<unsigned, WIDTH> cols;
+    const unsigned colCount {getColOrder(search, state, tableCol, cols)};
+
+    const Score alphaOrigin {alpha};
+    Score best {Scores::INVALID_MOVE};
+    unsigned bestCol {WIDTH};
+    unsigned index {0};
+    for (; index < colCount; ++index)
+    {
+        const unsigned col {cols[index]};
+        const Score score {(index == 0 ? getNegamaxScoreCol : getPvsScoreCol)(search, state, col, recursionLevel, alpha, beta, splitPoint)};
+        if (isAborted(search, splitPoint))
+        {
+            return 0;
+        }
+
+        if (score > best)
+        {
+            best = score;
+            bestCol = col;
+        }
+        if (best >= beta)
+        {
+            break;
+        }
+        alpha = std::max(alpha, best);
+
+        if (search.split && recursionLevel >= SplitPoint::MIN_RECURSION_LEVEL && _pool.getThreadCount() > 1)
+        {
+            ++index;
+            break;
+        }
+    }
+
+    if (best < beta && index < colCount)
+    {
+        SplitPoint node(splitPoint, alpha, beta, best, bestCol);
+        if (recursionLevel >= SplitPoint::TRACE_RECURSION_LEVEL)
+        {
+            Telemetry::get().trace(Telemetry::EventType::SPLIT, recursionLevel, bestCol, best);
+        }
+        ThreadPool::Group group;
+        for (; index < colCount; ++index)
+        {
+            const unsigned col {cols[index]};
+            _pool.submit(group, [&search, &state, &node, col, recursionLevel]
+            {
+                if (isAborted(search, &node))
+                {
+                    return;
+                }
+                // every task walks its own copy of the state
+                State taskState {state};
+                const Score score {getPvsScoreCol(search, taskState, col, recursionLevel, node.getAlpha(), node.beta, &node)};
+                if (!isAborted(search, &node))
+                {
+                    node.update(col, score);
+                }
+            });
+        }
+        _pool.wait(group);
+
+        if (isAborted(search, splitPoint))
+        {
+            return 0;
+        }
+        best = node.best;
+        bestCol = node.bestCol;
+    }
+
+    const TranspositionTable::Bound bound {best <= alphaOrigin ? TranspositionTable::Bound::UPPER :
+                                           best >= beta        ? TranspositionTable::Bound::LOWER :
+                                                                 TranspositionTable::Bound::EXACT};
+    if (bound == TranspositionTable::Bound::LOWER)
+    {
+        search.addCutoff(state, bestCol, recursionLevel, bestCol == cols[0]);
+    }
+    _table.store(key, best, recursionLevel, bound, mirrored ? getMirrorCol(bestCol) : bestCol);
+
+    return best;
+}
+
+// Score of playing col, seen from the player to move in state. The column
+// is played and taken back in place, state is unchanged on return.
+// The legacy recursion negates the child score only when player has just
+// played, and discounts it with getRecursionScore: both are monotonic, so
+// the child window is the preimage of (alpha, beta) through them.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Score BasicComputer<W, H>::getNegamaxScoreCol(Search& search, State& state, const unsigned col, const unsigned recursionLevel, const Score alpha, const Score beta, const SplitPoint* splitPoint)
+{
+    const bool negate {search.player == state.getTurn()};
+    state.addPosition(col);
+
+    Score score;
+    if (!getScoreColCached(search, state, score))
+    {
+        if (negate)
+        {
+            score = -getRecursionScore(negamax(search, state, recursionLevel - 1,
+                                               getMaxRecursionPreimage(-beta, search.weights),
+                                               getMinRecursionPreimage(-alpha, search.weights), splitPoint),
+                                       search.weights);
+        }
+        else
+        {
+            score = getRecursionScore(negamax(search, state, recursionLevel - 1,
+                                              getMaxRecursionPreimage(alpha, search.weights),
+                                              getMinRecursionPreimage(beta, search.weights), splitPoint),
+                                      search.weights);
+        }
+    }
+
+    state.undoPosition();
+    return score;
+}
+
+// getNegamaxScoreCol of a column after the first one. With PVS a null
+// window first tells whether it beats alpha, only then is it searched
+// again with the full window.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Score BasicComputer<W, H>::getPvsScoreCol(Search& search, State& state, const unsigned col, const unsigned recursionLevel, const Score alpha, const Score beta, const SplitPoint* splitPoint)
+{
+    if (search.window >= Window::PVS && alpha > -Scores::INFINITE && beta - alpha > 1)
+    {
+        const Score score {getNegamaxScoreCol(search, state, col, recursionLevel, alpha, alpha + 1, splitPoint)};
+        if (score <= alpha || score >= beta || isAborted(search, splitPoint))
+        {
+            return score;
+        }
+    }
+    return getNegamaxScoreCol(search, state, col, recursionLevel, alpha, beta, splitPoint);
+}
+
+// getFinalScoreCol through the table: final scores are stored, and a
+// position holding a search result is known not to be final. The non final
+// score is not kept, score is only set when it is final.
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::getScoreColCached(const Search& search, const State& state, Score& score)
+{
+    bool mirrored;
+    const uint64_t key {getTableKey(search, state, mirrored)};
+    TranspositionTable::Entry entry;
+    if (_table.probe(key, entry))
+    {
+        score = entry.score;
+        return entry.bound == TranspositionTable::Bound::FINAL;
+    }
+
+    if (!getFinalScoreCol(state, search.weights, score))
+    {
+        return false;
+    }
+    _table.store(key, score, 0, TranspositionTable::Bound::FINAL, WIDTH);
+    return true;
+}
+
+// The scores depend on whether the search player is to move and on the
+// weights. When the board key leaves room, the player takes the top bit and
+// the weights tag the bits in between, larger boards mix them in a hash.
+// A position and its mirror share the key of Board::getCanonicalKey,
+// mirrored tells the table columns are those of the mirror.
+template <unsigned W, unsigned H>
+uint64_t BasicComputer<W, H>::getTableKey(const Search& search, const State& state, bool& mirrored)
+{
+    const Bitboard key {state.getBoard().getKey()};
+    const Bitboard mirrorKey {Board::getMirror(key)};
+    mirrored = mirrorKey < key;
+    const uint64_t hash {Board::getHash(mirrored ? mirrorKey : key)};
+
+    const bool playerToMove {search.player == state.getTurn()};
+    if constexpr (TAG_BITS >= MIN_TAG_BITS)
+    {
+        return hash | (playerToMove ? uint64_t{1} << 63 : 0) | search.tableTag;
+    }
+    else
+    {
+        return hash ^ (playerToMove ? 0x9e3779b97f4a7c15ull : 0) ^ search.tableTag;
+    }
+}
+
+// 0 for the default weights. Searches of other weights share the table
+// without reading each other's scores, but for a 1 in 2^TAG_BITS hash
+// collision of two weights.
+template <unsigned W, unsigned H>
+uint64_t BasicComputer<W, H>::getTableTag(const Weights& weights)
+{
+    if (weights == Weights{})
+    {
+        return 0;
+    }
+
+    uint64_t hash {14695981039346656037ull}; // FNV-1a
+    for (const int64_t value : {int64_t{weights.forcedMove}, int64_t{weights.doubleTrapMove}, int64_t{weights.trapMove},
+                                static_cast<int64_t>(weights.recursionFactor * 1e6)})
+    {
+        hash = (hash ^ static_cast<uint64_t>(value)) * 1099511628211ull;
+    }
+    if constexpr (TAG_BITS >= MIN_TAG_BITS)
+    {
+        return (hash % ((uint64_t{1} << TAG_BITS) - 1) + 1) << Board::KEY_BITS;
+    }
+    else
+    {
+        return hash | 1;
+    }
+}
+
+// An entry of the cache setup opened at least options.recursionLevel deep,
+// or a final one. A timed search may reach any depth, it only takes a final
+// entry. Like the book, the cache holds one of a position and its mirror,
+// keyed as the table keeps the results of other weights apart. The entry
+// holds the score of its column only: the other scores stay invalid.
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::probeCache(const State& state, const Options& options, Analysis& analysis)
+{
+    ResultCache::Entry entry {};
+    if (options.cacheFile.empty() ||
+        !_cache.probe(state.getBoard().getCanonicalHash() ^ getTableTag(options.weights), entry))
+    {
+        return false;
+    }
+    const bool final {(entry.depth & ResultCache::FINAL) != 0};
+    const unsigned depth {entry.depth & (ResultCache::FINAL - 1u)};
+    if (!final && (options.moveTime.count() > 0 || depth < options.recursionLevel))
+    {
+        return false;
+    }
+
+    const unsigned col {state.getBoard().isMirrored() ? getMirrorCol(entry.col) : entry.col};
+    if (!state.isColValid(col))
+    {
+        return false;
+    }
+    Scores scores;
+    scores[col] = entry.score;
+    analysis = Analysis{col, entry.score, scores, 0, depth};
+    return true;
+}
+
+// Queued for the cache writer, the caller never waits on the disk. The
+// search stopped at the column when getFinalScoreCol tells it is final.
+template <unsigned W, unsigned H>
+void BasicComputer<W, H>::addToCache(const State& state, const Options& options, const Analysis& analysis)
+{
+    if (options.cacheFile.empty() || analysis.recursionLevel == 0)
+    {
+        return;
+    }
+
+    State nextState {state};
+    nextState.addPosition(analysis.col);
+    Score score;
+    const bool final {getFinalScoreCol(nextState, options.weights, score) && score == analysis.score};
+
+    const unsigned col {state.getBoard().isMirrored() ? getMirrorCol(analysis.col) : analysis.col};
+    const unsigned depth {std::min(analysis.recursionLevel, ResultCache::FINAL - 1u) | (final ? ResultCache::FINAL : 0u)};
+    _cache.add(ResultCache::Entry{state.getBoard().getCanonicalHash() ^ getTableTag(options.weights), analysis.score,
+                                  static_cast<uint8_t>(depth), static_cast<uint8_t>(col), 0});
+}
+
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::isFinalScore(const Score score, const Weights& weights)
+{
+    return score == Scores::WIN_MOVE ||
+           score == weights.doubleTrapMove ||
+           score == weights.forcedMove;
+}
+
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Score BasicComputer<W, H>::getRecursionScore(const Score score, const Weights& weights)
+{
+    return static_cast<Score>(static_cast<double>(score) / weights.recursionFactor);
+}
+
+// Largest child score whose recursion score is <= score. A recursion score
+// <= score means a child score < (score + 1) * recursionFactor, the search
+// starts right above it.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Score BasicComputer<W, H>::getMaxRecursionPreimage(const Score score, const Weights& weights)
+{
+    if (score <= -Scores::INFINITE || score >= Scores::INFINITE)
+    {
+        return score;
+    }
+    Score preimage {static_cast<Score>((score + 1) * weights.recursionFactor) + 1};
+    while (getRecursionScore(preimage, weights) > score)
+    {
+        --preimage;
+    }
+    return preimage;
+}
+
+// Smallest child score whose recursion score is >= score, above
+// (score - 1) * recursionFactor.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Score BasicComputer<W, H>::getMinRecursionPreimage(const Score score, const Weights& weights)
+{
+    if (score <= -Scores::INFINITE || score >= Scores::INFINITE)
+    {
+        return score;
+    }
+    Score preimage {static_cast<Score>((score - 1) * weights.recursionFactor) - 1};
+    while (getRecursionScore(preimage, weights) < score)
+    {
+        ++preimage;
+    }
+    return preimage;
+}
+
+// score of the last column played in state
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Score BasicComputer<W, H>::getScoreCol(const State& state, const Weights& weights)
+{
+    Telemetry::get().evaluations.add();
+
+    if (state.isDone()) // check if winning move
+    {
+        return Scores::WIN_MOVE;
+    }
+
+    // EVALUATION
+    const Board& board {state.getBoard()};
+    const char player {getOpponent(state.getTurn())}; // get last played
+
+    // future win for opponent: don't play
+    const Evaluation opponentEvaluation {getEvaluation(board, getOpponent(player))};
+    if (opponentEvaluation.threats != 0)
+    {
+        return weights.forcedMove;
+    }
+
+    const Evaluation evaluation {getEvaluation(board, player)};
+    if (evaluation.doubles != 0)
+    {
+        return weights.doubleTrapMove;
+    }
+
+    // seven // double lines // 3 in a row
+    // --> 2 forced moves in same col
+    // --> 2 forced moves in the same board
+    const unsigned forceMoveCount {Board::getCount(evaluation.threats)};
+    if (forceMoveCount > 1)
+    {
+        return weights.doubleTrapMove;
+    }
+    if (forceMoveCount == 1)
+    {
+        return weights.trapMove;
+    }
+
+    return 0;
+}
+
+// Score of the last column played in state, true when it ends the search:
+// the exact score of the tablebase, or a final score of getScoreCol. A
+// tablebase draw is final with the 0 of an open position, finality is told
+// by the result rather than by the score.
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::getFinalScoreCol(const State& state, const Weights& weights, Score& score)
+{
+    if (getScoreColTablebase(state, weights, score))
+    {
+        return true;
+    }
+    score = getScoreCol(state, weights);
+    return isFinalScore(score, weights);
+}
+
+// Exact score of the last column played in state when the tablebase holds
+// state, for the player of the column: winning scores as a winning move,
+// losing as a forced move, a draw 0.
+template <unsigned W, unsigned H>
+bool BasicComputer<W, H>::getScoreColTablebase(const State& state, const Weights& weights, Score& score)
+{
+    int tablebaseScore;
+    if (state.isDone() || !_tablebase.isCovered(WIDTH * HEIGHT - state.getMoveCount()) ||
+        !_tablebase.probe(state.getBoard().getCanonicalHash(), tablebaseScore))
+    {
+        return false;
+    }
+
+    // the tablebase scores the player to move, the opponent
+    score = tablebaseScore < 0 ? Scores::WIN_MOVE : tablebaseScore > 0 ? weights.forcedMove : 0;
+    return true;
+}
+
+// The legacy passes marked 'F' every empty cell completing four, then went
+// down each column turning the lower of two stacked 'F' into 'D', skipping
+// cells already turned. In a stack of n 'F' starting at the playable cell,
+// that cell ends up 'D' when n is even: runs[n - 1] holds the playable cells
+// starting a stack of at least n.
+template <unsigned W, unsigned H>
+typename BasicComputer<W, H>::Evaluation BasicComputer<W, H>::getEvaluation(const Board& board, const char player)
+{
+    const Bitboard winningCells {Board::getWinningCells(board.getStones(player), board.getMask())};
+
+    std::array<Bitboard, HEIGHT> runs;
+    runs[0] = winningCells & board.getPlayableCells();
+    for (unsigned row=1; row < HEIGHT; ++row)
+    {
+        runs[row] = runs[row - 1] & (winningCells >> row);
+    }
+
+    Bitboard doubles {0};
+    for (unsigned row=1; row < HEIGHT; row += 2)
+    {
+        doubles |= runs[row] & ~(row + 1 < HEIGHT ? runs[row + 1] : 0);
+    }
+
+    return Evaluation{runs[0], doubles};
+}
+
+using Computer = BasicComputer<WIDTH, HEIGHT>;
+
 #endif // COMPUTER_HPP
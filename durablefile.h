@@ -0,0 +1,72 @@
+#ifndef DURABLEFILE_H
+#define DURABLEFILE_H
+
+#include <cerrno>
+#include <cstdio>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Replaces a file so that a crash at any point leaves either the old file
+// or the new one whole under its name: the new content is written next to
+// it and synced, renamed over it, then the directory is synced so the
+// rename itself survives.
+struct DurableFile
+{
+    // write(fd) fills the new file, false drops it and keeps fileName as is
+    template <typename Write>
+    static bool replace(const std::string& fileName, const Write& write)
+    {
+        const std::string tmpFileName {fileName + ".tmp"};
+        const int fd {::open(tmpFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)};
+        if (fd < 0)
+        {
+            return false;
+        }
+        const bool written {write(fd) && fsync(fd) == 0};
+        ::close(fd);
+        if (!written || std::rename(tmpFileName.c_str(), fileName.c_str()) != 0)
+        {
+            std::remove(tmpFileName.c_str());
+            return false;
+        }
+        syncDirectory(fileName);
+        return true;
+    }
+
+    static bool writeAll(const int fd, const void* data, size_t size)
+    {
+        const char* bytes {static_cast<const char*>(data)};
+        while (size > 0)
+        {
+            const ssize_t written {::write(fd, bytes, size)};
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (written <= 0)
+            {
+                return false;
+            }
+            bytes += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    // the rename survives a crash once the directory is synced
+    static void syncDirectory(const std::string& fileName)
+    {
+        const size_t slash {fileName.rfind('/')};
+        const std::string directory {slash == std::string::npos ? "." : slash == 0 ? "/" : fileName.substr(0, slash)};
+        const int fd {::open(directory.c_str(), O_RDONLY | O_DIRECTORY)};
+        if (fd >= 0)
+        {
+            fsync(fd);
+            ::close(fd);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include "board.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Win checks and threats of many positions at once, for both players. The
+// positions and the results are stored column by column, one array per
+// field, and a kernel evaluates as many positions per instruction as its
+// vectors hold 64-bit bitboards. Every kernel runs the same operations,
+// their results are the same bit for bit. The vector kernels are compiled
+// for their instruction set alone and picked at runtime; boards of more
+// than 64 bits are always evaluated by the scalar one.
+template <unsigned W, unsigned H>
+struct BasicEvaluator
+{
+    using Board = BasicBoard<W, H>;
+    using Bitboard = typename Board::Bitboard;
+
+    enum class Kernel
+    {
+        SCALAR, // one position at a time
+        SSE4,   // two
+        AVX2    // four
+    };
+
+    // index 0 of the results is the player to move, 1 its opponent
+    struct Batch
+    {
+        void resize(size_t count)
+        {
+            positions.resize(count);
+            masks.resize(count);
+            for (unsigned player=0; player < 2; ++player)
+            {
+                fours[player].resize(count);
+                threats[player].resize(count);
+                doubles[player].resize(count);
+            }
+        }
+
+        size_t size() const
+        {
+            return positions.size();
+        }
+
+        std::vector<Bitboard>                positions; // Board::getPosition
+        std::vector<Bitboard>                masks;     // Board::getMask
+        std::array<std::vector<Bitboard>, 2> fours;     // not 0 when four stones are aligned
+        std::array<std::vector<Bitboard>, 2> threats;   // playable cells completing four
+        std::array<std::vector<Bitboard>, 2> doubles;   // threats under another winning cell, as Computer evaluates them
+    };
+
+    // the widest kernel the processor runs
+    static Kernel getKernel()
+    {
+#if defined(__x86_64__)
+        if (Board::KEY_BITS <= 64)
+        {
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return Kernel::AVX2;
+            }
+            if (__builtin_cpu_supports("sse4.1"))
+            {
+                return Kernel::SSE4;
+            }
+        }
+#endif
+        return Kernel::SCALAR;
+    }
+
+    static void evaluate(Batch& batch)
+    {
+        evaluate(batch, getKernel());
+    }
+
+    // kernel must run on this processor
+    static void evaluate(Batch& batch, const Kernel kernel)
+    {
+        size_t begin {0};
+#if defined(__x86_64__)
+        if constexpr (Board::KEY_BITS <= 64)
+        {
+            if (kernel == Kernel::AVX2)
+            {
+                begin = evaluateAvx2(batch);
+            }
+            else if (kernel == Kernel::SSE4)
+            {
+                begin = evaluateSse4(batch);
+            }
+        }
+#endif
+        // the positions left over by the vectors
+        for (size_t index=begin; index < batch.size(); ++index)
+        {
+            evaluate<Bitboard>(batch, index);
+        }
+    }
+
+private:
+#if defined(__x86_64__)
+    using Vector2 = uint64_t __attribute__((vector_size(16)));
+    using Vector4 = uint64_t __attribute__((vector_size(32)));
+
+    // both return the count of positions they evaluated
+    __attribute__((target("avx2"))) static size_t evaluateAvx2(Batch& batch)
+    {
+        size_t index {0};
+        for (; index + 4 <= batch.size(); index += 4)
+        {
+            evaluate<Vector4>(batch, index);
+        }
+        return index;
+    }
+
+    __attribute__((target("sse4.1"))) static size_t evaluateSse4(Batch& batch)
+    {
+        size_t index {0};
+        for (; index + 2 <= batch.size(); index += 2)
+        {
+            evaluate<Vector2>(batch, index);
+        }
+        return index;
+    }
+#endif
+
+    // the positions from index on, as many as V holds
+    template <typename V>
+    __attribute__((always_inline)) static inline void evaluate(Batch& batch, const size_t index)
+    {
+        V position;
+        V mask;
+        load<V>(batch.positions, index, position);
+        load<V>(batch.masks, index, mask);
+        const V playable {(mask + Board::bottomMask()) & Board::boardMask()};
+        const V opponent {position ^ mask};
+        evaluate<V>(batch, index, 0, position, mask, playable);
+        evaluate<V>(batch, index, 1, opponent, mask, playable);
+    }
+
+    // Board::isAligned, Board::getWinningCells and Computer::getEvaluation
+    // on the stones of one player
+    template <typename V>
+    __attribute__((always_inline)) static inline void evaluate(Batch& batch, const size_t index, const unsigned player,
+                                                               const V& stones, const V& mask, const V& playable)
+    {
+        const V vertical {stones & (stones >> 1)};
+        V fours {vertical & (vertical >> 2)};
+        V cells {(stones << 1) & (stones << 2) & (stones << 3)};
+        for (const unsigned shift : {H + 1, H, H + 2}) // horizontal, diagonal, anti diagonal
+        {
+            const V pairs {stones & (stones >> shift)};
+            fours |= pairs & (pairs >> (2 * shift));
+
+            V pair {(stones << shift) & (stones << (2 * shift))};
+            cells |= pair & (stones << (3 * shift));
+            cells |= pair & (stones >> shift);
+            pair = (stones >> shift) & (stones >> (2 * shift));
+            cells |= pair & (stones << shift);
+            cells |= pair & (stones >> (3 * shift));
+        }
+        cells &= mask ^ Board::boardMask();
+
+        std::array<V, H> runs;
+        runs[0] = cells & playable;
+        for (unsigned row=1; row < H; ++row)
+        {
+            runs[row] = runs[row - 1] & (cells >> row);
+        }
+        V doubles {runs[0] & 0};
+        for (unsigned row=1; row < H; row += 2)
+        {
+            doubles |= runs[row] & ~(row + 1 < H ? runs[row + 1] : runs[0] & 0);
+        }
+
+        store<V>(batch.fours[player], index, fours);
+        store<V>(batch.threats[player], index, runs[0]);
+        store<V>(batch.doubles[player], index, doubles);
+    }
+
+    // vectors are passed by reference, their calling convention depends on the instruction set
+    template <typename V>
+    __attribute__((always_inline)) static inline void load(const std::vector<Bitboard>& values, const size_t index, V& value)
+    {
+        std::memcpy(&value, values.data() + index, sizeof(value));
+    }
+
+    template <typename V>
+    __attribute__((always_inline)) static inline void store(std::vector<Bitboard>& values, const size_t index, const V& value)
+    {
+        std::memcpy(values.data() + index, &value, sizeof(value));
+    }
+};
+
+using Evaluator = BasicEvaluator<WIDTH, HEIGHT>;
+
+#endif
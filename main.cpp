@@ -4,7 +4,7 @@
 #include "player.h"
 #include "computer.hpp"
 
-int main()
+int main(int argc, char** argv)
 {
     char pTurn {' '};
     while (pTurn != P1 && pTurn != P2)
@@ -15,9 +15,34 @@ int main()
 
     State state(pTurn);
 
-    unsigned recursionLevel = 4;
+    Computer::Options options;
+    if (argc > 1)
+    {
+        options.bookFile = argv[1];
+    }
+    if (argc > 2)
+    {
+        options.cacheFile = argv[2];
+    }
+    if (argc > 3)
+    {
+        options.tablebaseFile = argv[3];
+    }
     std::cout << "COMPUTER RECURSION LEVEL: ";
-    std::cin >> recursionLevel;
+    std::cin >> options.recursionLevel;
+
+    unsigned engine = 1;
+    std::cout << "COMPUTER ENGINE [0 LEGACY|1 NEGAMAX]: ";
+    std::cin >> engine;
+    options.engine = engine == 0 ? Computer::Engine::LEGACY : Computer::Engine::NEGAMAX;
+
+    if (options.engine == Computer::Engine::NEGAMAX)
+    {
+        unsigned moveTime = 0;
+        std::cout << "COMPUTER MOVE TIME [ms, 0 FIXED RECURSION LEVEL]: ";
+        std::cin >> moveTime;
+        options.moveTime = std::chrono::milliseconds{moveTime};
+    }
 
     while(!state.isDone())
     {
@@ -28,16 +53,22 @@ int main()
         {
             if (state.getTurn() == P1)
             {
+                // the computer searches the replies to every column while the player thinks
+                if (options.engine == Computer::Engine::NEGAMAX)
+                {
+                    Computer::startPondering(state, options);
+                }
                 do
                 {
                     std::cout << "ENTER COL: ";
                     std::cin >> col;
                 }
                 while(!state.isColValid(col));
+                Computer::stopPondering(col);
             }
             else // if computer
             {
-                col = Computer::getCol(state, recursionLevel);
+                col = Computer::getCol(state, options);
             }
         }
         while (!state.isColValid(col));
@@ -0,0 +1,171 @@
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "state.h"
+#include "player.h"
+#include "computer.hpp"
+
+// Line protocol for a process embedding the engine, one command per line:
+//   position [MOVES]                        the columns played from 1 to WIDTH ("4453")
+//   go [depth N] [movetime MS] [infinite]   searches the position on its own thread
+//   stop                                    ends the search at once
+//   isready                                 answers readyok
+//   quit
+// A search answers, when it completes or is stopped,
+//   info depth D score S nodes N time MS
+//   bestmove COL
+// with the best column of its last completed depth, "bestmove none" when
+// the game is done. Commands are read while it runs, a go stops the
+// previous search. The tables stay warm from one search to the next.
+struct Protocol
+{
+    using Clock = std::chrono::steady_clock;
+
+    Protocol(std::ostream& output, const Computer::Options& options) :
+        _output(output), _options(options), _state(P1)
+    {}
+
+    // false once quit
+    bool execute(const std::string& line)
+    {
+        std::istringstream stream(line);
+        std::string command;
+        stream >> command;
+        if (command == "position")
+        {
+            std::string moves;
+            stream >> moves;
+            if (!setPosition(moves))
+            {
+                write("error invalid position " + moves);
+            }
+        }
+        else if (command == "go")
+        {
+            go(stream);
+        }
+        else if (command == "stop")
+        {
+            Computer::stopSearch();
+        }
+        else if (command == "isready")
+        {
+            write("readyok");
+        }
+        else if (command == "quit")
+        {
+            Computer::stopSearch();
+            return false;
+        }
+        else if (!command.empty())
+        {
+            write("error unknown command " + command);
+        }
+        return true;
+    }
+
+private:
+    bool setPosition(const std::string& moves)
+    {
+        State state(P1);
+        if (!state.addPositions(moves))
+        {
+            return false;
+        }
+        _state = state;
+        return true;
+    }
+
+    void go(std::istream& stream)
+    {
+        Computer::stopSearch();
+
+        Computer::Options options {_options};
+        std::string key;
+        while (stream >> key)
+        {
+            if (key == "depth")
+            {
+                stream >> options.recursionLevel;
+                options.moveTime = std::chrono::milliseconds{0};
+            }
+            else if (key == "movetime")
+            {
+                unsigned moveTime {0};
+                stream >> moveTime;
+                options.moveTime = std::chrono::milliseconds{moveTime};
+            }
+            else if (key == "infinite")
+            {
+                options.recursionLevel = WIDTH * HEIGHT;
+                options.moveTime = std::chrono::milliseconds{0};
+            }
+            else
+            {
+                write("error unknown go option " + key);
+                return;
+            }
+        }
+
+        if (_state.isDone())
+        {
+            write("bestmove none");
+            return;
+        }
+
+        const auto timeBegin {Clock::now()};
+        Computer::startSearch(_state, options, [this, timeBegin](const Computer::Analysis& analysis)
+        {
+            const std::chrono::duration<double, std::milli> duration {Clock::now() - timeBegin};
+            std::ostringstream info;
+            info << "info depth " << analysis.recursionLevel << " score " << analysis.score
+                 << " nodes " << analysis.nodes << " time " << duration.count();
+            write(info.str());
+            write("bestmove " + std::to_string(analysis.col + 1));
+        });
+    }
+
+    // the search thread writes too
+    void write(const std::string& line)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _output << line << std::endl;
+    }
+
+    std::ostream&            _output;
+    const Computer::Options& _options;
+    std::mutex               _mutex;
+    State                    _state;
+};
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && (std::string{argv[1]} == "-h" || std::string{argv[1]} == "--help"))
+    {
+        std::cout << "USAGE: " << argv[0] << " [THREADS] [TABLE_MB]\n";
+        return 1;
+    }
+
+    Computer::Options options;
+    if (argc > 1)
+    {
+        options.threads = std::stoul(argv[1]);
+    }
+    if (argc > 2)
+    {
+        options.tableSize = std::stoul(argv[2]) << 20;
+    }
+    Computer::setup(options);
+
+    Protocol protocol(std::cout, options);
+    std::string line;
+    while (std::getline(std::cin, line) && protocol.execute(line))
+    {}
+    Computer::stopSearch();
+
+    return 0;
+}
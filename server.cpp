@@ -0,0 +1,651 @@
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "state.h"
+#include "player.h"
+#include "computer.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// The searches of every session, on a fixed count of workers each searching
+// on its own thread, sharing the Computer table. Every connection has its
+// own queue and the workers serve the queues in turn, so a connection with
+// many games cannot starve the others. A request searches until its
+// deadline, counted from its arrival: the time it waited is taken from its
+// search, a request already late searches one level.
+struct Scheduler
+{
+    struct Request
+    {
+        uint64_t          connection;
+        uint64_t          session;
+        State             state;
+        Computer::Options options;  // a moveTime of 0 searches recursionLevel, without deadline
+        Clock::time_point arrival;
+    };
+
+    struct Result
+    {
+        uint64_t           connection;
+        uint64_t           session;
+        Computer::Analysis analysis;
+        Clock::duration    latency;  // from the arrival of the request
+    };
+
+    // done is called on the worker threads
+    Scheduler(const unsigned workerCount, const std::function<void(const Result&)>& done) :
+        _done(done), _queued(0), _stopped(false)
+    {
+        for (unsigned worker=0; worker < workerCount; ++worker)
+        {
+            _workers.emplace_back([this] { workLoop(); });
+        }
+    }
+
+    ~Scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopped = true;
+        }
+        _condition.notify_all();
+        for (std::thread& worker : _workers)
+        {
+            worker.join();
+        }
+    }
+
+    void submit(Request&& request)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::deque<Request>& queue {_queues[request.connection]};
+            if (queue.empty())
+            {
+                _turns.push_back(request.connection);
+            }
+            queue.push_back(std::move(request));
+            ++_queued;
+        }
+        _condition.notify_one();
+    }
+
+    // drops the requests of connection not started yet
+    void cancel(const uint64_t connection)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const auto queue {_queues.find(connection)};
+        if (queue != std::end(_queues))
+        {
+            _queued -= queue->second.size();
+            _queues.erase(queue);
+            _turns.erase(std::remove(std::begin(_turns), std::end(_turns), connection), std::end(_turns));
+        }
+    }
+
+    size_t getQueued()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _queued;
+    }
+
+private:
+    void workLoop()
+    {
+        while (true)
+        {
+            Request request {pop()};
+            if (request.connection == 0)
+            {
+                return;
+            }
+
+            Computer::Options options {request.options};
+            if (options.moveTime.count() > 0)
+            {
+                const auto remaining {std::chrono::duration_cast<std::chrono::milliseconds>(request.arrival + options.moveTime - Clock::now())};
+                if (remaining.count() > 0)
+                {
+                    options.moveTime = remaining;
+                }
+                else
+                {
+                    options.moveTime = std::chrono::milliseconds{0};
+                    options.recursionLevel = 1;
+                }
+            }
+
+            const Computer::Analysis analysis {Computer::analyse(request.state, options)};
+            _done(Result{request.connection, request.session, analysis, Clock::now() - request.arrival});
+        }
+    }
+
+    // the first request of the next connection in turn, connection 0 once stopped
+    Request pop()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this] { return _stopped || !_turns.empty(); });
+        if (_stopped)
+        {
+            return Request{0, 0, State(P1), Computer::Options{}, Clock::time_point{}};
+        }
+
+        const uint64_t connection {_turns.front()};
+        _turns.pop_front();
+        std::deque<Request>& queue {_queues[connection]};
+        Request request {std::move(queue.front())};
+        queue.pop_front();
+        --_queued;
+        if (queue.empty())
+        {
+            _queues.erase(connection);
+        }
+        else
+        {
+            _turns.push_back(connection);
+        }
+        return request;
+    }
+
+    const std::function<void(const Result&)>             _done;
+    std::vector<std::thread>                             _workers;
+    std::mutex                                           _mutex;
+    std::condition_variable                              _condition;
+    std::unordered_map<uint64_t, std::deque<Request>>    _queues;
+    std::deque<uint64_t>                                 _turns;   // connections with queued requests, in serving order
+    size_t                                               _queued;
+    bool                                                 _stopped;
+};
+
+// Game sessions over a local socket, one command per line, any number of
+// sessions per connection:
+//   new [MOVES]                            answers session ID, MOVES the columns played from 1 to WIDTH
+//   play ID MOVES                          answers ok ID
+//   go ID [depth N] [movetime MS]          answers bestmove ID COL SCORE DEPTH once searched, and plays COL
+//   close ID                               answers closed ID
+//   stats                                  answers stats sessions S queued Q moves M movespersec R p50 MS p99 MS
+// Errors answer error ID TEXT. Only the loop thread touches the sessions and
+// the connections, the workers hand their results back through an eventfd.
+struct Server
+{
+    static constexpr size_t MAX_LINE {4096};
+    static constexpr size_t LATENCY_COUNT {1 << 14}; // the latest, for the percentiles
+
+    Server(const int listenFd, const unsigned workerCount, const Computer::Options& options) :
+        _listenFd(listenFd), _epollFd(epoll_create1(0)), _eventFd(eventfd(0, EFD_NONBLOCK)), _options(options),
+        _nextConnection(FIRST_CONNECTION), _nextSession(1), _moves(0), _timeBegin(Clock::now()),
+        _scheduler(workerCount, [this](const Scheduler::Result& result) { addResult(result); })
+    {
+        addEvents(_listenFd, LISTEN, EPOLLIN);
+        addEvents(_eventFd, EVENT, EPOLLIN);
+    }
+
+    ~Server()
+    {
+        ::close(_eventFd);
+        ::close(_epollFd);
+    }
+
+    void run()
+    {
+        std::array<epoll_event, 256> events;
+        while (true)
+        {
+            const int count {epoll_wait(_epollFd, events.data(), events.size(), -1)};
+            for (int index=0; index < count; ++index)
+            {
+                const uint64_t id {events[index].data.u64};
+                if (id == LISTEN)
+                {
+                    accept();
+                }
+                else if (id == EVENT)
+                {
+                    completeResults();
+                }
+                else if (_connections.count(id) != 0)
+                {
+                    if (events[index].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                    {
+                        read(id);
+                    }
+                    if (_connections.count(id) != 0 && (events[index].events & EPOLLOUT))
+                    {
+                        flush(id);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t LISTEN {0};
+    static constexpr uint64_t EVENT {1};
+    static constexpr uint64_t FIRST_CONNECTION {2};
+
+    struct Connection
+    {
+        int                   fd;
+        std::string           input;
+        std::string           output;
+        std::vector<uint64_t> sessions;
+    };
+
+    struct Session
+    {
+        uint64_t connection;
+        State    state;
+        bool     searching;
+    };
+
+    void addEvents(const int fd, const uint64_t id, const uint32_t events)
+    {
+        epoll_event event {};
+        event.events = events;
+        event.data.u64 = id;
+        epoll_ctl(_epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    void setEvents(const int fd, const uint64_t id, const uint32_t events)
+    {
+        epoll_event event {};
+        event.events = events;
+        event.data.u64 = id;
+        epoll_ctl(_epollFd, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    void accept()
+    {
+        const int fd {::accept4(_listenFd, nullptr, nullptr, SOCK_NONBLOCK)};
+        if (fd < 0)
+        {
+            return;
+        }
+        const uint64_t id {_nextConnection++};
+        _connections[id] = Connection{fd, {}, {}, {}};
+        addEvents(fd, id, EPOLLIN);
+    }
+
+    void read(const uint64_t id)
+    {
+        Connection& connection {_connections[id]};
+        char buffer[4096];
+        const ssize_t size {::read(connection.fd, buffer, sizeof(buffer))};
+        if (size <= 0)
+        {
+            if (size == 0 || (errno != EAGAIN && errno != EINTR))
+            {
+                close(id);
+            }
+            return;
+        }
+
+        connection.input.append(buffer, size);
+        size_t begin {0};
+        for (size_t end {connection.input.find('\n')}; end != std::string::npos; end = connection.input.find('\n', begin))
+        {
+            execute(id, connection.input.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        connection.input.erase(0, begin);
+        if (connection.input.size() > MAX_LINE)
+        {
+            close(id);
+        }
+    }
+
+    void write(const uint64_t id, const std::string& line)
+    {
+        Connection& connection {_connections[id]};
+        const bool idle {connection.output.empty()};
+        connection.output += line;
+        connection.output += '\n';
+        if (idle)
+        {
+            flush(id);
+        }
+    }
+
+    // Sends what the socket takes, the rest once it is writable again. A
+    // broken connection is shut down, its next read closes it.
+    void flush(const uint64_t id)
+    {
+        Connection& connection {_connections[id]};
+        while (!connection.output.empty())
+        {
+            const ssize_t size {::send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL)};
+            if (size < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    setEvents(connection.fd, id, EPOLLIN | EPOLLOUT);
+                    return;
+                }
+                if (errno != EINTR)
+                {
+                    connection.output.clear();
+                    shutdown(connection.fd, SHUT_RDWR);
+                    break;
+                }
+                continue;
+            }
+            connection.output.erase(0, size);
+        }
+        setEvents(connection.fd, id, EPOLLIN);
+    }
+
+    // its sessions end with it, their searches in progress complete unread
+    void close(const uint64_t id)
+    {
+        Connection& connection {_connections[id]};
+        for (const uint64_t session : connection.sessions)
+        {
+            _sessions.erase(session);
+        }
+        _scheduler.cancel(id);
+        epoll_ctl(_epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+        ::close(connection.fd);
+        _connections.erase(id);
+    }
+
+    void execute(const uint64_t id, const std::string& line)
+    {
+        std::istringstream stream(line);
+        std::string command;
+        stream >> command;
+        if (command == "new")
+        {
+            std::string moves;
+            stream >> moves;
+            State state(P1);
+            if (!state.addPositions(moves))
+            {
+                write(id, "error 0 invalid moves " + moves);
+                return;
+            }
+            const uint64_t session {_nextSession++};
+            _sessions.emplace(session, Session{id, state, false});
+            _connections[id].sessions.push_back(session);
+            write(id, "session " + std::to_string(session));
+            return;
+        }
+        if (command == "stats")
+        {
+            write(id, getStats());
+            return;
+        }
+        if (command.empty())
+        {
+            return;
+        }
+
+        uint64_t sessionId {0};
+        stream >> sessionId;
+        const std::string sessionName {std::to_string(sessionId)};
+        const auto session {_sessions.find(sessionId)};
+        if (session == std::end(_sessions) || session->second.connection != id)
+        {
+            write(id, "error " + sessionName + " unknown session");
+        }
+        else if (command == "close")
+        {
+            std::vector<uint64_t>& sessions {_connections[id].sessions};
+            sessions.erase(std::remove(std::begin(sessions), std::end(sessions), sessionId), std::end(sessions));
+            _sessions.erase(session);
+            write(id, "closed " + sessionName);
+        }
+        else if (session->second.searching)
+        {
+            write(id, "error " + sessionName + " searching");
+        }
+        else if (command == "play")
+        {
+            std::string moves;
+            stream >> moves;
+            State state {session->second.state};
+            if (!state.addPositions(moves))
+            {
+                write(id, "error " + sessionName + " invalid moves " + moves);
+                return;
+            }
+            session->second.state = state;
+            write(id, "ok " + sessionName);
+        }
+        else if (command == "go")
+        {
+            go(id, session->second, sessionId, stream);
+        }
+        else
+        {
+            write(id, "error " + sessionName + " unknown command " + command);
+        }
+    }
+
+    void go(const uint64_t id, Session& session, const uint64_t sessionId, std::istream& stream)
+    {
+        const std::string sessionName {std::to_string(sessionId)};
+        Computer::Options options {_options};
+        std::string key;
+        unsigned value;
+        while (stream >> key >> value)
+        {
+            if (key == "depth")
+            {
+                options.recursionLevel = value;
+                options.moveTime = std::chrono::milliseconds{0};
+            }
+            else if (key == "movetime")
+            {
+                options.moveTime = std::chrono::milliseconds{value};
+            }
+            else
+            {
+                write(id, "error " + sessionName + " unknown go option " + key);
+                return;
+            }
+        }
+
+        if (session.state.isDone())
+        {
+            write(id, "bestmove " + sessionName + " none");
+            return;
+        }
+        session.searching = true;
+        _scheduler.submit(Scheduler::Request{id, sessionId, session.state, options, Clock::now()});
+    }
+
+    // on the worker threads
+    void addResult(const Scheduler::Result& result)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_resultsMutex);
+            _results.push_back(result);
+        }
+        const uint64_t one {1};
+        ::write(_eventFd, &one, sizeof(one));
+    }
+
+    void completeResults()
+    {
+        uint64_t count;
+        ::read(_eventFd, &count, sizeof(count));
+
+        std::vector<Scheduler::Result> results;
+        {
+            std::lock_guard<std::mutex> lock(_resultsMutex);
+            results.swap(_results);
+        }
+
+        for (const Scheduler::Result& result : results)
+        {
+            const double latency {std::chrono::duration<double, std::milli>(result.latency).count()};
+            if (_latencies.size() < LATENCY_COUNT)
+            {
+                _latencies.push_back(latency);
+            }
+            else
+            {
+                _latencies[_moves % LATENCY_COUNT] = latency;
+            }
+            ++_moves;
+
+            // the session or its connection may have been closed meanwhile
+            const auto session {_sessions.find(result.session)};
+            if (session == std::end(_sessions))
+            {
+                continue;
+            }
+            session->second.state.addPosition(result.analysis.col);
+            session->second.searching = false;
+            write(result.connection, "bestmove " + std::to_string(result.session) + " " + std::to_string(result.analysis.col + 1) +
+                                     " " + std::to_string(result.analysis.score) + " " + std::to_string(result.analysis.recursionLevel));
+        }
+    }
+
+    std::string getStats()
+    {
+        std::vector<double> latencies {_latencies};
+        std::sort(std::begin(latencies), std::end(latencies));
+        // nearest rank: the smallest latency at least percentile of the latencies are at most
+        const auto getPercentile = [&latencies](const double percentile)
+        {
+            if (latencies.empty())
+            {
+                return 0.0;
+            }
+            const size_t rank {static_cast<size_t>(std::ceil(percentile * latencies.size()))};
+            return latencies[std::min(latencies.size(), std::max<size_t>(rank, 1)) - 1];
+        };
+        const std::chrono::duration<double> duration {Clock::now() - _timeBegin};
+
+        std::ostringstream stats;
+        stats << "stats sessions " << _sessions.size() << " queued " << _scheduler.getQueued()
+              << " moves " << _moves << " movespersec " << _moves / duration.count()
+              << " p50 " << getPercentile(0.5) << " p99 " << getPercentile(0.99);
+        return stats.str();
+    }
+
+    const int                                  _listenFd;
+    const int                                  _epollFd;
+    const int                                  _eventFd;
+    const Computer::Options                    _options;
+
+    std::unordered_map<uint64_t, Connection>   _connections;
+    std::unordered_map<uint64_t, Session>      _sessions;
+    uint64_t                                   _nextConnection;
+    uint64_t                                   _nextSession;
+    uint64_t                                   _moves;
+    std::vector<double>                        _latencies; // ms
+    const Clock::time_point                    _timeBegin;
+
+    std::mutex                                 _resultsMutex;
+    std::vector<Scheduler::Result>             _results;
+    Scheduler                                  _scheduler; // last, its workers stop first
+};
+
+// a TCP port on localhost when address is a number, a Unix socket path otherwise
+static int listenOn(const std::string& address)
+{
+    int fd;
+    if (address.find_first_not_of("0123456789") == std::string::npos)
+    {
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        const int reuse {1};
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in socketAddress {};
+        socketAddress.sin_family = AF_INET;
+        socketAddress.sin_port = htons(static_cast<uint16_t>(std::stoul(address)));
+        socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+    }
+    else
+    {
+        sockaddr_un socketAddress {};
+        if (address.size() >= sizeof(socketAddress.sun_path))
+        {
+            return -1;
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        socketAddress.sun_family = AF_UNIX;
+        std::strcpy(socketAddress.sun_path, address.c_str());
+        unlink(address.c_str());
+        if (bind(fd, reinterpret_cast<const sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, SOMAXCONN) != 0)
+    {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "USAGE: " << argv[0] << " SOCKET_PATH|PORT [WORKERS] [MOVE_TIME_MS] [TABLE_MB] [CACHE_FILE] [TABLEBASE_FILE]\n";
+        return 1;
+    }
+
+    Computer::Options options;
+    options.threads = 1; // the requests are searched in parallel, each on one worker
+    options.moveTime = std::chrono::milliseconds{argc > 3 ? std::stoul(argv[3]) : 100};
+    if (argc > 4)
+    {
+        options.tableSize = std::stoul(argv[4]) << 20;
+    }
+    if (argc > 5)
+    {
+        options.cacheFile = argv[5];
+    }
+    if (argc > 6)
+    {
+        options.tablebaseFile = argv[6];
+    }
+    Computer::setup(options);
+
+    const int listenFd {listenOn(argv[1])};
+    if (listenFd < 0)
+    {
+        std::cout << "CANNOT LISTEN ON " << argv[1] << "\n";
+        return 1;
+    }
+
+    const unsigned workerCount {argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : std::max(1u, std::thread::hardware_concurrency())};
+    std::signal(SIGPIPE, SIG_IGN);
+    Server(listenFd, workerCount, options).run();
+
+    return 0;
+}
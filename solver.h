@@ -0,0 +1,394 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "arena.h"
+#include "board.h"
+#include "state.h"
+#include "tablebase.h"
+#include "threadpool.h"
+#include "transposition.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+// Exact game-theoretic value of a position, independent of the Computer
+// heuristics. Scores count the moves left to the winner: a position won by
+// the player to move scores (WIDTH * HEIGHT + 1 - moves) / 2, where moves
+// is the number of stones on the board when the winning stone is played,
+// lost positions score the opposite, draws 0.
+// Null-window searches bisect the score range. Every null-window search is
+// run by the caller and by helper threads in other column orders, all
+// sharing the table: a helper result is exact too, whoever stores it.
+struct Solver
+{
+    enum class Value
+    {
+        LOSS = -1,
+        DRAW = 0,
+        WIN = 1
+    };
+
+    struct Options
+    {
+        unsigned    threads   {std::max(1u, std::thread::hardware_concurrency())};
+        size_t      tableSize {64 << 20}; // bytes
+        std::string tablebaseFile;        // scores the positions it holds at once, empty disables it
+    };
+
+    struct Result
+    {
+        Value    value;    // for the player to move
+        int      score;
+        unsigned distance; // plies to the end of the game, both players playing best
+        unsigned col;      // a best column, WIDTH when the game is done
+        uint64_t nodes;
+    };
+
+    static Result solve(const State& state, const Options& options);
+
+    // score of the position, and the distance to the end it encodes
+    static int solve(const Board& board, const unsigned moves, const Options& options, uint64_t& nodes);
+    static unsigned getDistance(const int score, const unsigned moves);
+
+    // the moves the scores are searched through, for the tablebase generator too
+    static Board::Bitboard getNonLosingMoves(const Board::Bitboard position, const Board::Bitboard mask);
+    static bool canWinNext(const Board::Bitboard position, const Board::Bitboard mask);
+
+private:
+    static constexpr unsigned CELL_COUNT {WIDTH * HEIGHT};
+
+    // one thread searching one null window
+    struct Search
+    {
+        Search(const unsigned rotation) : rotation(rotation), nodes(0), aborted(false)
+        {}
+
+        const unsigned        rotation; // column order offset of a helper
+        uint64_t              nodes;    // read once the search has returned
+        std::atomic<bool>     aborted;  // set once the caller has the result
+    };
+
+    static int search(const Board::Bitboard position, const Board::Bitboard mask, const unsigned moves, const int alpha, const int beta, uint64_t& nodes);
+    static int negamax(Search& search, const Board::Bitboard position, const Board::Bitboard mask, const unsigned moves, int alpha, int beta);
+
+    static unsigned getCenterOutCol(const unsigned index);
+    static unsigned getMoveScore(const Board::Bitboard position, const Board::Bitboard mask, const Board::Bitboard move);
+
+    static TranspositionTable _table;
+    static ThreadPool         _pool;
+    static Tablebase          _tablebase;
+};
+
+TranspositionTable Solver::_table;
+ThreadPool         Solver::_pool;
+Tablebase          Solver::_tablebase;
+
+Solver::Result Solver::solve(const State& state, const Options& options)
+{
+    const Board& board {state.getBoard()};
+    const unsigned moves {state.getMoveCount()};
+    if (state.isDone())
+    {
+        const int score {state.getWinner() == P0 ? 0 : -static_cast<int>(CELL_COUNT + 2 - moves) / 2};
+        return Result{score == 0 ? Value::DRAW : Value::LOSS, score, 0, WIDTH, 0};
+    }
+
+    uint64_t nodes {0};
+    const int score {solve(board, moves, options, nodes)};
+
+    // the first column keeping the score, in the center out order
+    unsigned bestCol {WIDTH};
+    for (unsigned index=0; index < WIDTH && bestCol == WIDTH; ++index)
+    {
+        const unsigned col {getCenterOutCol(index)};
+        if (!board.isColValid(col))
+        {
+            continue;
+        }
+
+        const Board::Bitboard move {(board.getMask() + Board::bottomMask(col)) & Board::columnMask(col)};
+        if ((Board::getWinningCells(board.getPosition(), board.getMask()) & move) != 0)
+        {
+            if (static_cast<int>(CELL_COUNT + 1 - moves) / 2 == score)
+            {
+                bestCol = col;
+            }
+            continue;
+        }
+
+        const Board::Bitboard childPosition {board.getPosition() ^ board.getMask()};
+        const Board::Bitboard childMask {board.getMask() | move};
+        if (moves + 1 == CELL_COUNT)
+        {
+            if (score == 0)
+            {
+                bestCol = col;
+            }
+        }
+        else if (!canWinNext(childPosition, childMask) &&
+                 -search(childPosition, childMask, moves + 1, -score, -score + 1, nodes) >= score)
+        {
+            bestCol = col;
+        }
+    }
+
+    // every column loses at once
+    for (unsigned col=0; col < WIDTH && bestCol == WIDTH; ++col)
+    {
+        if (board.isColValid(col))
+        {
+            bestCol = col;
+        }
+    }
+
+    const Value value {score > 0 ? Value::WIN : score < 0 ? Value::LOSS : Value::DRAW};
+    return Result{value, score, getDistance(score, moves), bestCol, nodes};
+}
+
+// the position of board, with moves stones, must not be done
+int Solver::solve(const Board& board, const unsigned moves, const Options& options, uint64_t& nodes)
+{
+    _table.resize(options.tableSize, TranspositionTable::Replacement::DEPTH);
+    _pool.resize(options.threads);
+    Arena::get().reserve((_pool.getThreadCount() - 1) * sizeof(Search));
+    _tablebase.setFile(options.tablebaseFile, WIDTH, HEIGHT);
+
+    if (canWinNext(board.getPosition(), board.getMask()))
+    {
+        return static_cast<int>(CELL_COUNT + 1 - moves) / 2;
+    }
+
+    int min {-static_cast<int>(CELL_COUNT - moves) / 2};
+    int max {static_cast<int>(CELL_COUNT + 1 - moves) / 2};
+    while (min < max)
+    {
+        // bisect, leaning towards 0 where most positions end
+        int med {min + (max - min) / 2};
+        if (med <= 0 && min / 2 < med)
+        {
+            med = min / 2;
+        }
+        else if (med >= 0 && max / 2 > med)
+        {
+            med = max / 2;
+        }
+
+        const int score {search(board.getPosition(), board.getMask(), moves, med, med + 1, nodes)};
+        if (score <= med)
+        {
+            max = score;
+        }
+        else
+        {
+            min = score;
+        }
+    }
+    return min;
+}
+
+// plies until the winning stone, or until the board is full on a draw
+unsigned Solver::getDistance(const int score, const unsigned moves)
+{
+    if (score == 0)
+    {
+        return CELL_COUNT - moves;
+    }
+
+    // the winner plays the last stone, at the parity of its moves
+    const unsigned winnerMoves {score > 0 ? moves : moves + 1};
+    unsigned lastMoves {CELL_COUNT + 1 - 2 * static_cast<unsigned>(std::abs(score))};
+    if ((lastMoves - winnerMoves) % 2 != 0)
+    {
+        --lastMoves;
+    }
+    return lastMoves - moves + 1;
+}
+
+// One null-window search, with helper threads racing the caller
+int Solver::search(const Board::Bitboard position, const Board::Bitboard mask, const unsigned moves, const int alpha, const int beta, uint64_t& nodes)
+{
+    const unsigned helperCount {_pool.getThreadCount() - 1};
+    Arena& arena {Arena::get()};
+    const Arena::Scope scope(arena);
+
+    ThreadPool::Group group;
+    Search* helperSearches {nullptr};
+    for (unsigned helper=1; helper <= helperCount; ++helper)
+    {
+        Search& helperSearch {arena.create<Search>(helper)};
+        if (helper == 1)
+        {
+            helperSearches = &helperSearch;
+        }
+        _pool.submit(group, [&helperSearch, position, mask, moves, alpha, beta]
+        {
+            negamax(helperSearch, position, mask, moves, alpha, beta);
+        });
+    }
+
+    Search mainSearch(0);
+    const int score {negamax(mainSearch, position, mask, moves, alpha, beta)};
+    nodes += mainSearch.nodes;
+
+    for (unsigned index=0; index < helperCount; ++index)
+    {
+        helperSearches[index].aborted.store(true, std::memory_order_relaxed);
+    }
+    _pool.wait(group);
+    for (unsigned index=0; index < helperCount; ++index)
+    {
+        nodes += helperSearches[index].nodes;
+    }
+
+    return score;
+}
+
+// Fail-soft alpha-beta on the exact score. The player to move cannot win
+// with its next stone. A position of the tablebase returns its score. An
+// aborted search returns a meaningless score and stores nothing.
+int Solver::negamax(Search& search, const Board::Bitboard position, const Board::Bitboard mask, const unsigned moves, int alpha, int beta)
+{
+    ++search.nodes;
+    if (search.aborted.load(std::memory_order_relaxed))
+    {
+        return 0;
+    }
+
+    const Board::Bitboard next {getNonLosingMoves(position, mask)};
+    if (next == 0)
+    {
+        return -static_cast<int>(CELL_COUNT - moves) / 2;
+    }
+    if (moves >= CELL_COUNT - 2)
+    {
+        return 0;
+    }
+
+    // the opponent cannot win with its next stone
+    const int min {-static_cast<int>(CELL_COUNT - 2 - moves) / 2};
+    if (alpha < min)
+    {
+        alpha = min;
+        if (alpha >= beta)
+        {
+            return alpha;
+        }
+    }
+    // neither can the player to move
+    int max {static_cast<int>(CELL_COUNT - 1 - moves) / 2};
+
+    // a position and its mirror share their entry
+    const uint64_t key {std::min(position + mask, Board::getMirror(position + mask))};
+    int tablebaseScore;
+    if (_tablebase.isCovered(CELL_COUNT - moves) && _tablebase.probe(Board::getHash(key), tablebaseScore))
+    {
+        return tablebaseScore;
+    }
+    TranspositionTable::Entry entry;
+    if (_table.probe(key, entry))
+    {
+        if (entry.bound == TranspositionTable::Bound::LOWER && entry.score > alpha)
+        {
+            alpha = entry.score;
+            if (alpha >= beta)
+            {
+                return alpha;
+            }
+        }
+        else if (entry.bound == TranspositionTable::Bound::UPPER)
+        {
+            max = std::min(max, static_cast<int>(entry.score));
+        }
+    }
+    if (beta > max)
+    {
+        beta = max;
+        if (alpha >= beta)
+        {
+            return beta;
+        }
+    }
+
+    // the moves making the most threats first, from the center out on ties
+    std::array<std::pair<unsigned, Board::Bitboard>, WIDTH> sorted;
+    unsigned moveCount {0};
+    for (unsigned index=0; index < WIDTH; ++index)
+    {
+        const unsigned col {getCenterOutCol((index + search.rotation) % WIDTH)};
+        const Board::Bitboard move {next & Board::columnMask(col)};
+        if (move == 0)
+        {
+            continue;
+        }
+
+        const unsigned score {getMoveScore(position, mask, move)};
+        unsigned slot {moveCount++};
+        for (; slot > 0 && sorted[slot - 1].first < score; --slot)
+        {
+            sorted[slot] = sorted[slot - 1];
+        }
+        sorted[slot] = {score, move};
+    }
+
+    for (unsigned index=0; index < moveCount; ++index)
+    {
+        const Board::Bitboard move {sorted[index].second};
+        const int score {-negamax(search, position ^ mask, mask | move, moves + 1, -beta, -alpha)};
+        if (search.aborted.load(std::memory_order_relaxed))
+        {
+            return 0;
+        }
+
+        if (score >= beta)
+        {
+            _table.store(key, score, CELL_COUNT - moves, TranspositionTable::Bound::LOWER, WIDTH);
+            return score;
+        }
+        alpha = std::max(alpha, score);
+    }
+
+    _table.store(key, alpha, CELL_COUNT - moves, TranspositionTable::Bound::UPPER, WIDTH);
+    return alpha;
+}
+
+unsigned Solver::getCenterOutCol(const unsigned index)
+{
+    const unsigned offset {(index + 1) / 2};
+    return index % 2 == 1 ? WIDTH / 2 - offset : WIDTH / 2 + offset;
+}
+
+// playable cells that do not give the opponent an immediate win
+Board::Bitboard Solver::getNonLosingMoves(const Board::Bitboard position, const Board::Bitboard mask)
+{
+    Board::Bitboard possible {(mask + Board::bottomMask()) & Board::boardMask()};
+    const Board::Bitboard opponentWins {Board::getWinningCells(position ^ mask, mask)};
+    const Board::Bitboard forced {possible & opponentWins};
+    if (forced != 0)
+    {
+        // two forced cells cannot both be blocked
+        if ((forced & (forced - 1)) != 0)
+        {
+            return 0;
+        }
+        possible = forced;
+    }
+    // never play below a winning cell of the opponent
+    return possible & ~(opponentWins >> 1);
+}
+
+bool Solver::canWinNext(const Board::Bitboard position, const Board::Bitboard mask)
+{
+    return (Board::getWinningCells(position, mask) & (mask + Board::bottomMask()) & Board::boardMask()) != 0;
+}
+
+// winning cells the move leaves to the player who plays it
+unsigned Solver::getMoveScore(const Board::Bitboard position, const Board::Bitboard mask, const Board::Bitboard move)
+{
+    return Board::getCount(Board::getWinningCells(position | move, mask | move));
+}
+
+#endif
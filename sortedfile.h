@@ -0,0 +1,154 @@
+#ifndef SORTEDFILE_H
+#define SORTEDFILE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "durablefile.h"
+
+// Read-only file of a header followed by entries sorted by key, the layout
+// of the book and the tablebase. The file is mapped as is, opening it costs
+// no parsing and a probe is a binary search over the mapping. Header starts
+// with magic, width and height and holds entryCount, getKey(entry) gives
+// the key entries are sorted by.
+template <typename Header, typename Entry>
+struct SortedFile
+{
+    SortedFile() : _data(nullptr), _size(0), _header(nullptr), _entries(nullptr)
+    {}
+
+    ~SortedFile()
+    {
+        close();
+    }
+
+    SortedFile(const SortedFile&) = delete;
+    SortedFile& operator=(const SortedFile&) = delete;
+
+    // maps fileName, a no-op when it is already open
+    bool open(const std::string& fileName, const char (&magic)[8], unsigned width, unsigned height)
+    {
+        if (isOpen() && fileName == _fileName)
+        {
+            return true;
+        }
+        close();
+
+        const int fd {::open(fileName.c_str(), O_RDONLY)};
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat status;
+        void* data {MAP_FAILED};
+        if (fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(Header))
+        {
+            data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+
+        _data = data;
+        _size = status.st_size;
+        _header = static_cast<const Header*>(_data);
+        _entries = reinterpret_cast<const Entry*>(_header + 1);
+        if (std::memcmp(_header->magic, magic, sizeof(magic)) != 0 ||
+            _header->width != width || _header->height != height ||
+            _size != sizeof(Header) + _header->entryCount * sizeof(Entry))
+        {
+            close();
+            return false;
+        }
+
+        madvise(_data, _size, MADV_RANDOM);
+        _fileName = fileName;
+        return true;
+    }
+
+    void close()
+    {
+        if (_data != nullptr)
+        {
+            munmap(_data, _size);
+        }
+        _data = nullptr;
+        _size = 0;
+        _header = nullptr;
+        _entries = nullptr;
+        _fileName.clear();
+    }
+
+    bool isOpen() const
+    {
+        return _data != nullptr;
+    }
+
+    const Header& getHeader() const
+    {
+        return *_header;
+    }
+
+    // the entry of key, nullptr when there is none or the file is closed
+    template <typename GetKey>
+    const Entry* find(uint64_t key, const GetKey& getKey) const
+    {
+        if (!isOpen())
+        {
+            return nullptr;
+        }
+
+        const Entry* const end {_entries + _header->entryCount};
+        const Entry* const entry {std::lower_bound(_entries, end, key, [&getKey](const Entry& lhs, uint64_t rhs)
+        {
+            return getKey(lhs) < rhs;
+        })};
+        return entry == end || getKey(*entry) != key ? nullptr : entry;
+    }
+
+    // Sorts entries, keeps one per key and writes them through
+    // DurableFile::replace: a crash or a failed write keeps an existing file
+    // whole.
+    template <typename GetKey>
+    static bool write(const std::string& fileName, const char (&magic)[8], Header header, std::vector<Entry>& entries,
+                      const GetKey& getKey)
+    {
+        std::sort(std::begin(entries), std::end(entries), [&getKey](const Entry& lhs, const Entry& rhs)
+        {
+            return getKey(lhs) < getKey(rhs);
+        });
+        entries.erase(std::unique(std::begin(entries), std::end(entries), [&getKey](const Entry& lhs, const Entry& rhs)
+        {
+            return getKey(lhs) == getKey(rhs);
+        }), std::end(entries));
+
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.entryCount = entries.size();
+
+        return DurableFile::replace(fileName, [&header, &entries](const int fd)
+        {
+            return DurableFile::writeAll(fd, &header, sizeof(header)) &&
+                   DurableFile::writeAll(fd, entries.data(), entries.size() * sizeof(Entry));
+        });
+    }
+
+private:
+    void*         _data;
+    size_t        _size;
+    const Header* _header;
+    const Entry*  _entries;
+    std::string   _fileName;
+};
+
+#endif
@@ -4,9 +4,19 @@
 #include "player.h"
 #include "board.h"
 
-struct State
+#include <array>
+#include <cstdint>
+#include <string>
+
+template <unsigned W, unsigned H>
+struct BasicState
 {
-    explicit State(char pTurn) : _pTurn(pTurn), _pWin(P0), _done(false)
+    static constexpr unsigned WIDTH {W};
+    static constexpr unsigned HEIGHT {H};
+
+    using Board = BasicBoard<W, H>;
+
+    explicit BasicState(char pTurn) : _pTurn(pTurn), _pWin(P0), _done(false), _moveCount(0)
     {}
 
     char getTurn() const
@@ -31,11 +41,12 @@ struct State
 
     void addPosition(unsigned col)
     {
-        _board[_board.getTopRow(col)][col] = _pTurn;
+        _board.addPosition(col, _pTurn);
+        _moves[_moveCount++] = static_cast<uint8_t>(col);
         if (!_board.isDone(_pTurn))
         {
             _pTurn = getOpponent(_pTurn);
-            if (_board.isFull())
+            if (_moveCount == WIDTH * HEIGHT)
             {
                 _done = true;
             }
@@ -47,23 +58,52 @@ struct State
         }
     }
 
+    // Plays moves written as the columns from 1 to WIDTH ("4453"). False on
+    // a move that is not a column, a full column or a move after the end of
+    // the game, the moves before it are played.
+    bool addPositions(const std::string& moves)
+    {
+        for (const char move : moves)
+        {
+            const unsigned col {static_cast<unsigned>(move - '1')};
+            if (col >= WIDTH || !isColValid(col) || _done)
+            {
+                return false;
+            }
+            addPosition(col);
+        }
+        return true;
+    }
+
+    // takes back the last addPosition, the game was not done before it
+    void undoPosition()
+    {
+        const unsigned col {_moves[--_moveCount]};
+        const char player {_board[_board.getHeight(col) - 1][col]};
+        _board.removePosition(col);
+        _pTurn = player;
+        _pWin  = P0;
+        _done  = false;
+    }
+
+    unsigned getMoveCount() const
+    {
+        return _moveCount;
+    }
+
+    unsigned getMove(unsigned index) const
+    {
+        return _moves[index];
+    }
+
     bool isDone() const
     {
         return _done;
     }
 
-    friend std::ostream& operator<<(std::ostream& os, const State& state)
+    friend std::ostream& operator<<(std::ostream& os, const BasicState& state)
     {
-        os << "|-|-|-|-|-|-|-|\n";
-        for (int row=5; row >= 0; --row)
-        {
-            for (int col=0; col < 7; ++col)
-            {
-                os << "|" << state._board[row][col];
-            }
-            os << "|\n";
-        }
-        os << "|-|-|-|-|-|-|-|\n";
+        os << state._board;
         os << "TURN: " << playerToString(state._pTurn) << '\n';
         return os;
     }
@@ -74,10 +114,14 @@ struct State
     }
 
 private:
-    Board  _board;
-    char   _pTurn;
-    char   _pWin;
-    bool   _done;
+    Board                                _board;
+    char                                 _pTurn;
+    char                                 _pWin;
+    bool                                 _done;
+    uint8_t                              _moveCount;
+    std::array<uint8_t, WIDTH * HEIGHT>  _moves;
 };
 
+using State = BasicState<WIDTH, HEIGHT>;
+
 #endif
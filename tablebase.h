@@ -0,0 +1,122 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sortedfile.h"
+
+// Read-only exact scores of positions with at most maxEmpty empty cells, as
+// the Solver scores them, in a SortedFile of 8-byte entries.
+struct Tablebase
+{
+    static constexpr char MAGIC[8] {'C', '4', 'T', 'B', 'A', 'S', 'E', '1'};
+    static constexpr unsigned SCORE_BITS {8};
+
+    struct Header
+    {
+        char     magic[8];
+        uint32_t width;
+        uint32_t height;
+        uint32_t maxEmpty; // empty cells of the positions held, at most
+        uint32_t reserved;
+        uint64_t entryCount;
+    };
+    static_assert(sizeof(Header) == 32, "header must stay 32 bytes");
+
+    // Board::getCanonicalHash in the high bits, the score of the player to
+    // move in the low SCORE_BITS: sorting entries sorts their keys. The top
+    // SCORE_BITS bits of the hash are dropped, boards of up to 56 key bits
+    // keep exact keys.
+    using Entry = uint64_t;
+
+    static Entry getEntry(uint64_t key, int score)
+    {
+        return key << SCORE_BITS | static_cast<uint8_t>(static_cast<int8_t>(score));
+    }
+
+    static uint64_t getKey(Entry entry)
+    {
+        return entry >> SCORE_BITS;
+    }
+
+    static int getScore(Entry entry)
+    {
+        return static_cast<int8_t>(static_cast<uint8_t>(entry));
+    }
+
+    Tablebase() : _maxEmpty(0)
+    {}
+
+    // maps fileName, a no-op when it is already open
+    bool open(const std::string& fileName, unsigned width, unsigned height)
+    {
+        if (!_file.open(fileName, MAGIC, width, height))
+        {
+            _maxEmpty = 0;
+            return false;
+        }
+        _maxEmpty = _file.getHeader().maxEmpty;
+        return true;
+    }
+
+    // Opens fileName, an empty name closes the tablebase: a no-op while the
+    // file stays the same, a file failing to open leaves it closed.
+    void setFile(const std::string& fileName, unsigned width, unsigned height)
+    {
+        if (!fileName.empty())
+        {
+            open(fileName, width, height);
+        }
+        else if (isOpen())
+        {
+            close();
+        }
+    }
+
+    void close()
+    {
+        _file.close();
+        _maxEmpty = 0;
+    }
+
+    bool isOpen() const
+    {
+        return _file.isOpen();
+    }
+
+    const Header& getHeader() const
+    {
+        return _file.getHeader();
+    }
+
+    // positions with emptyCount empty cells may be held, never when closed
+    bool isCovered(unsigned emptyCount) const
+    {
+        return emptyCount <= _maxEmpty && isOpen();
+    }
+
+    bool probe(uint64_t key, int& score) const
+    {
+        const Entry* const entry {_file.find(key & ~uint64_t{0} >> SCORE_BITS, getKey)};
+        if (entry == nullptr)
+        {
+            return false;
+        }
+        score = getScore(*entry);
+        return true;
+    }
+
+    // sorted and written as SortedFile::write writes them
+    static bool write(const std::string& fileName, Header header, std::vector<Entry>& entries)
+    {
+        return SortedFile<Header, Entry>::write(fileName, MAGIC, header, entries, getKey);
+    }
+
+private:
+    SortedFile<Header, Entry> _file;
+    unsigned                  _maxEmpty; // of the open file, read on every probe
+};
+
+#endif
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "state.h"
+#include "player.h"
+#include "solver.h"
+#include "tablebase.h"
+
+// Scores by retrograde analysis every position with at most MAX_EMPTY empty
+// cells reachable from the seeds. Positions are kept in layers of equal
+// stone counts: the layers are expanded from the seeds to the full board,
+// then scored from the full board back, each position from the scores of
+// the next layer. Moves are those of the Solver, positions it would never
+// search are neither expanded nor kept.
+// Seeds are read as analyse reads positions, one game in progress per line
+// ("4453"), an empty line seeding the empty board. Seeds with more than
+// MAX_EMPTY empty cells are skipped: the positions between them and the
+// tablebase would outnumber it on the full-size board.
+
+static constexpr unsigned CELL_COUNT {WIDTH * HEIGHT};
+
+// a position of a layer, in the orientation of its canonical key
+struct Node
+{
+    Board::Bitboard position; // stones of the player to move
+    Board::Bitboard mask;
+
+    Board::Bitboard getKey() const
+    {
+        return position + mask;
+    }
+
+    static Node getCanonical(const Board::Bitboard position, const Board::Bitboard mask)
+    {
+        const Board::Bitboard key {position + mask};
+        if (Board::getMirror(key) < key)
+        {
+            return Node{Board::getMirror(position), Board::getMirror(mask)};
+        }
+        return Node{position, mask};
+    }
+};
+
+// Runs f(begin, end) over chunks of [0, count) on threadCount threads
+template <typename F>
+static void forChunks(const size_t count, const unsigned threadCount, const F& f)
+{
+    static constexpr size_t CHUNK_SIZE {4096};
+    std::atomic<size_t> next {0};
+    std::vector<std::thread> threads;
+    for (unsigned thread=0; thread < threadCount; ++thread)
+    {
+        threads.emplace_back([&]
+        {
+            for (size_t begin {next.fetch_add(CHUNK_SIZE)}; begin < count; begin = next.fetch_add(CHUNK_SIZE))
+            {
+                f(begin, std::min(begin + CHUNK_SIZE, count));
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+static void sortLayer(std::vector<Node>& layer)
+{
+    std::sort(std::begin(layer), std::end(layer), [](const Node& lhs, const Node& rhs)
+    {
+        return lhs.getKey() < rhs.getKey();
+    });
+    layer.erase(std::unique(std::begin(layer), std::end(layer), [](const Node& lhs, const Node& rhs)
+    {
+        return lhs.getKey() == rhs.getKey();
+    }), std::end(layer));
+}
+
+// the positions of the seeds file with at least minStones stones, by stone count
+static bool readSeeds(const std::string& fileName, const unsigned minStones, std::vector<std::vector<Node>>& layers)
+{
+    std::ifstream file(fileName);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        State state(P1);
+        if (!state.addPositions(line) || state.isDone() || state.getMoveCount() < minStones)
+        {
+            std::cout << "SKIPPED SEED " << line << "\n";
+            continue;
+        }
+
+        const Board& board {state.getBoard()};
+        layers[state.getMoveCount()].push_back(Node::getCanonical(board.getPosition(), board.getMask()));
+    }
+    return true;
+}
+
+// adds to the next layer the positions the Solver searches after each one
+// of layer, which must not be the last one before the board is full
+static void expand(const std::vector<Node>& layer, std::vector<Node>& nextLayer, const unsigned threadCount)
+{
+    std::mutex mutex;
+    forChunks(layer.size(), threadCount, [&](const size_t begin, const size_t end)
+    {
+        std::vector<Node> children;
+        for (size_t index=begin; index < end; ++index)
+        {
+            const Node& node {layer[index]};
+            if (Solver::canWinNext(node.position, node.mask))
+            {
+                continue;
+            }
+
+            const Board::Bitboard moves {Solver::getNonLosingMoves(node.position, node.mask)};
+            for (unsigned col=0; col < WIDTH; ++col)
+            {
+                const Board::Bitboard move {moves & Board::columnMask(col)};
+                if (move != 0)
+                {
+                    children.push_back(Node::getCanonical(node.position ^ node.mask, node.mask | move));
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        nextLayer.insert(std::end(nextLayer), std::begin(children), std::end(children));
+    });
+    sortLayer(nextLayer);
+}
+
+// Scores of layer, whose next layer is scored: as Solver::negamax scores
+// them, the best of the next positions once the immediate ends are known
+static void score(const std::vector<Node>& layer, const unsigned stones, const std::vector<Node>& nextLayer,
+                  const std::vector<int8_t>& nextScores, std::vector<int8_t>& scores, const unsigned threadCount)
+{
+    scores.resize(layer.size());
+    forChunks(layer.size(), threadCount, [&](const size_t begin, const size_t end)
+    {
+        for (size_t index=begin; index < end; ++index)
+        {
+            const Node& node {layer[index]};
+            const Board::Bitboard moves {Solver::getNonLosingMoves(node.position, node.mask)};
+            int best {-static_cast<int>(CELL_COUNT - stones) / 2};
+            if (Solver::canWinNext(node.position, node.mask))
+            {
+                best = static_cast<int>(CELL_COUNT + 1 - stones) / 2;
+            }
+            else if (moves != 0 && stones + 1 == CELL_COUNT)
+            {
+                best = 0;
+            }
+            else if (moves != 0)
+            {
+                for (unsigned col=0; col < WIDTH; ++col)
+                {
+                    const Board::Bitboard move {moves & Board::columnMask(col)};
+                    if (move == 0)
+                    {
+                        continue;
+                    }
+
+                    const Node child {Node::getCanonical(node.position ^ node.mask, node.mask | move)};
+                    const auto next {std::lower_bound(std::begin(nextLayer), std::end(nextLayer), child, [](const Node& lhs, const Node& rhs)
+                    {
+                        return lhs.getKey() < rhs.getKey();
+                    })};
+                    best = std::max(best, -static_cast<int>(nextScores[next - std::begin(nextLayer)]));
+                }
+            }
+            scores[index] = static_cast<int8_t>(best);
+        }
+    });
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        std::cout << "USAGE: " << argv[0] << " TABLEBASE_FILE MAX_EMPTY SEEDS_FILE [THREADS]\n";
+        return 1;
+    }
+
+    const std::string fileName {argv[1]};
+    const unsigned maxEmpty {std::min(static_cast<unsigned>(std::stoul(argv[2])), CELL_COUNT)};
+    const unsigned threadCount {argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : std::max(1u, std::thread::hardware_concurrency())};
+    std::vector<std::vector<Node>> layers(CELL_COUNT);
+    if (!readSeeds(argv[3], CELL_COUNT - maxEmpty, layers))
+    {
+        std::cout << "CANNOT READ " << argv[3] << "\n";
+        return 1;
+    }
+
+    const auto timeBegin {std::chrono::steady_clock::now()};
+    unsigned firstStones {CELL_COUNT};
+    for (unsigned stones=0; stones < CELL_COUNT; ++stones)
+    {
+        sortLayer(layers[stones]);
+        if (layers[stones].empty())
+        {
+            continue;
+        }
+        firstStones = std::min(firstStones, stones);
+
+        if (stones + 1 < CELL_COUNT)
+        {
+            expand(layers[stones], layers[stones + 1], threadCount);
+        }
+        std::cout << "STONES=" << stones << " POSITIONS=" << layers[stones].size() << "\n";
+    }
+
+    std::vector<std::vector<int8_t>> scores(CELL_COUNT);
+    std::vector<Tablebase::Entry> entries;
+    for (unsigned stones=CELL_COUNT; stones-- > firstStones;)
+    {
+        static const std::vector<Node> noLayer;
+        static const std::vector<int8_t> noScores;
+        const bool last {stones + 1 == CELL_COUNT};
+        score(layers[stones], stones, last ? noLayer : layers[stones + 1], last ? noScores : scores[stones + 1], scores[stones], threadCount);
+
+        for (size_t index=0; index < layers[stones].size(); ++index)
+        {
+            entries.push_back(Tablebase::getEntry(Board::getHash(layers[stones][index].getKey()), scores[stones][index]));
+        }
+        // the next layer is not read anymore
+        if (!last)
+        {
+            std::vector<Node>().swap(layers[stones + 1]);
+            std::vector<int8_t>().swap(scores[stones + 1]);
+        }
+    }
+
+    const std::chrono::duration<double> duration {std::chrono::steady_clock::now() - timeBegin};
+    std::cout << "SCORED IN " << duration.count() << "s\n";
+
+    Tablebase::Header header {};
+    header.width = WIDTH;
+    header.height = HEIGHT;
+    header.maxEmpty = maxEmpty;
+    if (!Tablebase::write(fileName, header, entries))
+    {
+        std::cout << "CANNOT WRITE " << fileName << "\n";
+        return 1;
+    }
+    std::cout << "TABLEBASE " << fileName << " ENTRIES=" << entries.size() << "\n";
+
+    return 0;
+}
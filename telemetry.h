@@ -0,0 +1,333 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Search counters and trace, per thread. Only the owning thread writes its
+// counters, with relaxed loads and stores instead of shared atomic adds, so
+// they are cheap enough to stay on. Any thread can sum them at any time.
+// The trace is a ring buffer per thread keeping the last TRACE_SIZE events;
+// it is read once the traced threads are done, after a search.
+struct Telemetry
+{
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t TRACE_SIZE {1 << 12};
+
+    struct Counters
+    {
+        uint64_t nodes;
+        uint64_t evaluations;
+        uint64_t cutoffs;
+        uint64_t firstCutoffs; // cutoffs by the first column searched
+        uint64_t tableProbes;
+        uint64_t tableHits;
+        uint64_t maxPly;       // deepest node below a root
+
+        Counters& operator+=(const Counters& counters)
+        {
+            nodes += counters.nodes;
+            evaluations += counters.evaluations;
+            cutoffs += counters.cutoffs;
+            firstCutoffs += counters.firstCutoffs;
+            tableProbes += counters.tableProbes;
+            tableHits += counters.tableHits;
+            maxPly = std::max(maxPly, counters.maxPly);
+            return *this;
+        }
+
+        // counts since begin, maxPly is kept as is
+        Counters operator-(const Counters& begin) const
+        {
+            return Counters{nodes - begin.nodes, evaluations - begin.evaluations, cutoffs - begin.cutoffs,
+                            firstCutoffs - begin.firstCutoffs, tableProbes - begin.tableProbes,
+                            tableHits - begin.tableHits, maxPly};
+        }
+
+        friend std::ostream& operator<<(std::ostream& os, const Counters& counters)
+        {
+            os << "NODES=" << counters.nodes << " EVALS=" << counters.evaluations
+               << " FIRST CUTOFFS=" << getPercent(counters.firstCutoffs, counters.cutoffs) << "% (" << counters.firstCutoffs << "/" << counters.cutoffs << ")"
+               << " TT hits=" << getPercent(counters.tableHits, counters.tableProbes) << "% (" << counters.tableHits << "/" << counters.tableProbes << ")"
+               << " MAX PLY=" << counters.maxPly;
+            return os;
+        }
+
+        static double getPercent(uint64_t count, uint64_t total)
+        {
+            return total == 0 ? 0.0 : 100.0 * count / total;
+        }
+
+        void writeJson(std::ostream& os) const
+        {
+            os << "{\"nodes\":" << nodes << ",\"evaluations\":" << evaluations
+               << ",\"cutoffs\":" << cutoffs << ",\"first_cutoffs\":" << firstCutoffs
+               << ",\"table_probes\":" << tableProbes << ",\"table_hits\":" << tableHits
+               << ",\"max_ply\":" << maxPly << "}";
+        }
+    };
+
+    enum class EventType : uint8_t
+    {
+        SEARCH, // a search started
+        LEVEL,  // an iterative deepening level completed
+        ROOT,   // a root column got its score
+        SPLIT,  // younger columns were given to the pool, near the root
+        ABORT   // the deadline stopped the search
+    };
+
+    struct Event
+    {
+        int64_t   time;   // ns, steady clock
+        int32_t   score;
+        uint8_t   level;  // recursion level
+        uint8_t   col;
+        EventType type;
+    };
+
+    // the only writes are done by the counting thread
+    struct Counter
+    {
+        Counter() : _value(0)
+        {}
+
+        void add(uint64_t count = 1)
+        {
+            _value.store(_value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        }
+
+        void setMax(uint64_t value)
+        {
+            if (value > _value.load(std::memory_order_relaxed))
+            {
+                _value.store(value, std::memory_order_relaxed);
+            }
+        }
+
+        uint64_t get() const
+        {
+            return _value.load(std::memory_order_relaxed);
+        }
+
+        void reset()
+        {
+            _value.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> _value;
+    };
+
+    struct alignas(64) ThreadTelemetry
+    {
+        ThreadTelemetry() : index(0), live(false), _traceCount(0)
+        {}
+
+        Counter nodes;
+        Counter evaluations;
+        Counter cutoffs;
+        Counter firstCutoffs;
+        Counter tableProbes;
+        Counter tableHits;
+        Counter maxPly;
+
+        Counters getCounters() const
+        {
+            return Counters{nodes.get(), evaluations.get(), cutoffs.get(), firstCutoffs.get(),
+                            tableProbes.get(), tableHits.get(), maxPly.get()};
+        }
+
+        void trace(EventType type, unsigned level, unsigned col, int score)
+        {
+            if (!isTraceEnabled())
+            {
+                return;
+            }
+            if (!_trace)
+            {
+                _trace.reset(new std::array<Event, TRACE_SIZE>);
+            }
+            const int64_t time {std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count()};
+            (*_trace)[_traceCount++ % TRACE_SIZE] = Event{time, score, static_cast<uint8_t>(level), static_cast<uint8_t>(col), type};
+        }
+
+        unsigned index; // in the order threads first counted
+        bool     live;  // its thread still runs
+
+    private:
+        friend struct Telemetry;
+
+        std::unique_ptr<std::array<Event, TRACE_SIZE>> _trace;
+        uint64_t                                       _traceCount;
+    };
+
+    // the telemetry of the calling thread
+    static ThreadTelemetry& get()
+    {
+        thread_local Holder holder;
+        return *holder.telemetry;
+    }
+
+    // every thread since the start, running or not
+    static Counters getTotal()
+    {
+        std::lock_guard<std::mutex> lock(getRegistry().mutex);
+        Counters total {getRegistry().retired};
+        for (const ThreadTelemetry& telemetry : getRegistry().threads)
+        {
+            if (telemetry.live)
+            {
+                total += telemetry.getCounters();
+            }
+        }
+        return total;
+    }
+
+    static void setTraceEnabled(bool enabled)
+    {
+        getTraceEnabled().store(enabled, std::memory_order_relaxed);
+    }
+
+    static bool isTraceEnabled()
+    {
+        return getTraceEnabled().load(std::memory_order_relaxed);
+    }
+
+    // forgets the events and the max ply of every thread, no thread may be searching
+    static void newSearch()
+    {
+        std::lock_guard<std::mutex> lock(getRegistry().mutex);
+        for (ThreadTelemetry& telemetry : getRegistry().threads)
+        {
+            telemetry.maxPly.reset();
+            telemetry._traceCount = 0;
+        }
+    }
+
+    // the counters and events of the running threads, no thread may be tracing
+    static void writeJson(std::ostream& os)
+    {
+        static constexpr const char* EVENT_NAMES[] {"search", "level", "root", "split", "abort"};
+
+        std::lock_guard<std::mutex> lock(getRegistry().mutex);
+        os << "{\"threads\":[";
+        bool first {true};
+        for (const ThreadTelemetry& telemetry : getRegistry().threads)
+        {
+            if (!telemetry.live)
+            {
+                continue;
+            }
+            os << (first ? "\n" : ",\n") << "{\"thread\":" << telemetry.index << ",\"counters\":";
+            telemetry.getCounters().writeJson(os);
+            os << "}";
+            first = false;
+        }
+        os << "\n],\n\"events\":[";
+
+        // the events of every thread, merged by time
+        std::vector<std::pair<Event, unsigned>> events;
+        for (const ThreadTelemetry& telemetry : getRegistry().threads)
+        {
+            if (!telemetry.live || !telemetry._trace)
+            {
+                continue;
+            }
+            const uint64_t begin {telemetry._traceCount > TRACE_SIZE ? telemetry._traceCount - TRACE_SIZE : 0};
+            for (uint64_t index=begin; index < telemetry._traceCount; ++index)
+            {
+                events.emplace_back((*telemetry._trace)[index % TRACE_SIZE], telemetry.index);
+            }
+        }
+        std::stable_sort(std::begin(events), std::end(events), [](const std::pair<Event, unsigned>& lhs, const std::pair<Event, unsigned>& rhs)
+        {
+            return lhs.first.time < rhs.first.time;
+        });
+
+        first = true;
+        for (const std::pair<Event, unsigned>& event : events)
+        {
+            os << (first ? "\n" : ",\n") << "{\"time\":" << event.first.time << ",\"thread\":" << event.second
+               << ",\"type\":\"" << EVENT_NAMES[static_cast<unsigned>(event.first.type)] << "\""
+               << ",\"level\":" << static_cast<unsigned>(event.first.level)
+               << ",\"col\":" << static_cast<unsigned>(event.first.col)
+               << ",\"score\":" << event.first.score << "}";
+            first = false;
+        }
+        os << "\n]}\n";
+    }
+
+private:
+    // the telemetry blocks are kept for the threads to come, the counts of
+    // the finished threads go to retired
+    struct Registry
+    {
+        std::mutex                  mutex;
+        std::deque<ThreadTelemetry> threads;
+        Counters                    retired {};
+    };
+
+    struct Holder
+    {
+        Holder()
+        {
+            Registry& registry {getRegistry()};
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (ThreadTelemetry& candidate : registry.threads)
+            {
+                if (!candidate.live)
+                {
+                    telemetry = &candidate;
+                    break;
+                }
+            }
+            if (telemetry == nullptr)
+            {
+                registry.threads.emplace_back();
+                telemetry = &registry.threads.back();
+                telemetry->index = static_cast<unsigned>(registry.threads.size() - 1);
+            }
+            telemetry->live = true;
+        }
+
+        ~Holder()
+        {
+            Registry& registry {getRegistry()};
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.retired += telemetry->getCounters();
+            for (Counter* counter : {&telemetry->nodes, &telemetry->evaluations, &telemetry->cutoffs, &telemetry->firstCutoffs,
+                                     &telemetry->tableProbes, &telemetry->tableHits, &telemetry->maxPly})
+            {
+                counter->reset();
+            }
+            telemetry->_traceCount = 0;
+            telemetry->live = false;
+        }
+
+        ThreadTelemetry* telemetry {nullptr};
+    };
+
+    // never destroyed, pool threads may still exit after static destructors
+    static Registry& getRegistry()
+    {
+        static Registry* registry {new Registry};
+        return *registry;
+    }
+
+    static std::atomic<bool>& getTraceEnabled()
+    {
+        static std::atomic<bool> enabled {false};
+        return enabled;
+    }
+};
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Long-lived work-stealing pool. Every worker owns a deque: it pops its
+// newest task, idle workers steal the oldest task of the others. The thread
+// waiting on a group runs pending tasks instead of blocking, so a pool of
+// threadCount threads runs threadCount - 1 workers plus the caller.
+// Submitting never allocates: tasks are stored in place, in deques of
+// QUEUE_SIZE tasks allocated with the pool; a task submitted to a full
+// deque runs at once on the submitting thread.
+struct ThreadPool
+{
+    static constexpr size_t QUEUE_SIZE {1024};
+
+    // a callable of at most CAPACITY bytes, copied as is
+    struct Task
+    {
+        static constexpr size_t CAPACITY {6 * sizeof(void*)};
+
+        Task() : _run(nullptr)
+        {}
+
+        template <typename F>
+        Task(const F& f) : _run([](const void* storage) { (*static_cast<const F*>(storage))(); })
+        {
+            static_assert(sizeof(F) <= CAPACITY, "the task captures too much");
+            static_assert(alignof(F) <= alignof(void*), "the task captures overaligned data");
+            static_assert(std::is_trivially_copyable<F>::value, "the task captures must be trivially copyable");
+            new (&_storage) F(f);
+        }
+
+        void operator()() const
+        {
+            _run(&_storage);
+        }
+
+    private:
+        typename std::aligned_storage<CAPACITY, alignof(void*)>::type _storage;
+        void (*_run)(const void*);
+    };
+
+    // tasks submitted together, waited for together
+    struct Group
+    {
+        Group() : _pending(0)
+        {}
+
+    private:
+        friend struct ThreadPool;
+        std::atomic<unsigned> _pending;
+    };
+
+    explicit ThreadPool(unsigned threadCount = 1) : _stop(false), _queued(0)
+    {
+        start(threadCount);
+    }
+
+    ~ThreadPool()
+    {
+        stop();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // no task may be pending while resizing
+    void resize(unsigned threadCount)
+    {
+        if (threadCount != getThreadCount())
+        {
+            stop();
+            start(threadCount);
+        }
+    }
+
+    unsigned getThreadCount() const
+    {
+        return static_cast<unsigned>(_queues.size());
+    }
+
+    void submit(Group& group, const Task& task)
+    {
+        Queue& queue {*_queues[getQueueIndex()]};
+        {
+            std::unique_lock<std::mutex> lock(queue.mutex);
+            if (queue.end - queue.begin == QUEUE_SIZE)
+            {
+                lock.unlock();
+                task();
+                return;
+            }
+            group._pending.fetch_add(1, std::memory_order_relaxed);
+            queue.tasks[queue.end++ % QUEUE_SIZE] = QueuedTask{task, &group};
+        }
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            ++_queued;
+        }
+        _sleepCondition.notify_one();
+    }
+
+    // runs pending tasks until every task of group has completed
+    void wait(Group& group)
+    {
+        while (group._pending.load(std::memory_order_acquire) != 0)
+        {
+            if (!runPendingTask())
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    struct QueuedTask
+    {
+        Task   task;
+        Group* group;
+    };
+
+    // tasks from begin to end, modulo QUEUE_SIZE
+    struct Queue
+    {
+        Queue() : tasks(QUEUE_SIZE), begin(0), end(0)
+        {}
+
+        std::mutex              mutex;
+        std::vector<QueuedTask> tasks;
+        size_t                  begin;
+        size_t                  end;
+    };
+
+    void start(unsigned threadCount)
+    {
+        threadCount = std::max(threadCount, 1u);
+        _stop = false;
+        _queued = 0;
+        for (unsigned index=0; index < threadCount; ++index)
+        {
+            _queues.emplace_back(new Queue);
+        }
+        // queue 0 belongs to the threads calling wait
+        for (unsigned index=1; index < threadCount; ++index)
+        {
+            _workers.emplace_back([this, index]
+            {
+                _workerPool = this;
+                _workerIndex = index;
+                workerLoop();
+            });
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            _stop = true;
+        }
+        _sleepCondition.notify_all();
+        for (std::thread& worker : _workers)
+        {
+            worker.join();
+        }
+        _workers.clear();
+        _queues.clear();
+    }
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            if (runPendingTask())
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(_sleepMutex);
+            _sleepCondition.wait(lock, [this] { return _stop || _queued > 0; });
+            if (_stop)
+            {
+                return;
+            }
+        }
+    }
+
+    bool runPendingTask()
+    {
+        QueuedTask queuedTask;
+        if (!popTask(queuedTask))
+        {
+            return false;
+        }
+
+        queuedTask.task();
+        queuedTask.group->_pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    // own newest task first, then the oldest task of the other queues
+    bool popTask(QueuedTask& queuedTask)
+    {
+        const unsigned ownIndex {getQueueIndex()};
+        const unsigned queueCount {getThreadCount()};
+        for (unsigned offset=0; offset < queueCount; ++offset)
+        {
+            Queue& queue {*_queues[(ownIndex + offset) % queueCount]};
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.begin == queue.end)
+            {
+                continue;
+            }
+
+            if (offset == 0)
+            {
+                queuedTask = queue.tasks[--queue.end % QUEUE_SIZE];
+            }
+            else
+            {
+                queuedTask = queue.tasks[queue.begin++ % QUEUE_SIZE];
+            }
+
+            std::lock_guard<std::mutex> sleepLock(_sleepMutex);
+            --_queued;
+            return true;
+        }
+        return false;
+    }
+
+    unsigned getQueueIndex() const
+    {
+        return _workerPool == this ? _workerIndex : 0;
+    }
+
+    static thread_local const ThreadPool* _workerPool;
+    static thread_local unsigned _workerIndex;
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread>            _workers;
+
+    std::mutex                          _sleepMutex;
+    std::condition_variable             _sleepCondition;
+    bool                                _stop;
+    unsigned                            _queued;
+};
+
+thread_local const ThreadPool* ThreadPool::_workerPool = nullptr;
+thread_local unsigned ThreadPool::_workerIndex = 0;
+
+#endif
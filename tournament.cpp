@@ -0,0 +1,321 @@
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "state.h"
+#include "player.h"
+#include "computer.hpp"
+
+// Plays two engine configurations against each other from every opening,
+// once with each side moving first, and reports the results of the first
+// one with its Elo difference. Every thread plays whole games, each move
+// searched by Computer::analyse on that thread: the games share the table,
+// the weights keep their entries apart.
+struct Tournament
+{
+    struct Engine
+    {
+        std::string       name;
+        Computer::Options options;
+    };
+
+    // counts of one engine, over its games and its moves
+    struct Results
+    {
+        uint64_t                 wins;
+        uint64_t                 draws;
+        uint64_t                 losses;
+        uint64_t                 moves;
+        uint64_t                 nodes;
+        std::chrono::nanoseconds time;
+
+        Results& operator+=(const Results& results)
+        {
+            wins += results.wins;
+            draws += results.draws;
+            losses += results.losses;
+            moves += results.moves;
+            nodes += results.nodes;
+            time += results.time;
+            return *this;
+        }
+    };
+
+    Tournament(const std::array<Engine, 2>& engines, const std::vector<State>& openings) :
+        _engines(engines), _openings(openings), _results{}, _next(0), _done(0)
+    {}
+
+    void run(const unsigned threadCount)
+    {
+        std::vector<std::thread> threads;
+        for (unsigned thread=0; thread < threadCount; ++thread)
+        {
+            threads.emplace_back([this] { playLoop(); });
+        }
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        std::cerr << "\n";
+    }
+
+    void report(std::ostream& os) const
+    {
+        for (unsigned engine=0; engine < 2; ++engine)
+        {
+            const Results& results {_results[engine]};
+            const double moves {static_cast<double>(std::max<uint64_t>(results.moves, 1))};
+            os << (engine == 0 ? "A " : "B ") << _engines[engine].name
+               << " WINS=" << results.wins << " DRAWS=" << results.draws << " LOSSES=" << results.losses
+               << " MOVE=" << std::chrono::duration<double, std::milli>(results.time).count() / moves << "ms"
+               << " NODES/MOVE=" << results.nodes / moves << "\n";
+        }
+
+        // the score of A per game is 1, 1/2 or 0, its mean and standard error
+        // give the Elo difference and its 95% confidence interval
+        const Results& results {_results[0]};
+        const double games {static_cast<double>(results.wins + results.draws + results.losses)};
+        const double score {(results.wins + 0.5 * results.draws) / games};
+        const double variance {(results.wins * (1.0 - score) * (1.0 - score) +
+                                results.draws * (0.5 - score) * (0.5 - score) +
+                                results.losses * score * score) / games};
+        const double error {1.96 * std::sqrt(variance / games)};
+        os << "GAMES=" << games << " SCORE=" << 100.0 * score << "%"
+           << " ELO=" << getElo(score) << " [" << getElo(score - error) << ", " << getElo(score + error) << "]\n";
+    }
+
+private:
+    void playLoop()
+    {
+        std::array<Results, 2> results {};
+        for (size_t game {_next++}; game < 2 * _openings.size(); game = _next++)
+        {
+            // A moves first in even games
+            State state {_openings[game / 2]};
+            const unsigned first {game % 2 == 0 ? 0u : 1u};
+            while (!state.isDone())
+            {
+                const unsigned engine {(state.getMoveCount() - _openings[game / 2].getMoveCount()) % 2 == 0 ? first : 1 - first};
+                const auto timeBegin {std::chrono::steady_clock::now()};
+                const Computer::Analysis analysis {Computer::analyse(state, _engines[engine].options)};
+                results[engine].time += std::chrono::steady_clock::now() - timeBegin;
+                results[engine].nodes += analysis.nodes;
+                ++results[engine].moves;
+                state.addPosition(analysis.col);
+            }
+
+            // the last stone played won, unless the board is full
+            const unsigned last {(state.getMoveCount() - 1 - _openings[game / 2].getMoveCount()) % 2 == 0 ? first : 1 - first};
+            if (state.getWinner() == P0)
+            {
+                ++results[0].draws;
+                ++results[1].draws;
+            }
+            else
+            {
+                ++results[last].wins;
+                ++results[1 - last].losses;
+            }
+
+            const size_t done {++_done};
+            std::cerr << "\rGAMES=" << done << "/" << 2 * _openings.size() << std::flush;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _results[0] += results[0];
+        _results[1] += results[1];
+    }
+
+    static double getElo(const double score)
+    {
+        if (score <= 0.0 || score >= 1.0)
+        {
+            return score <= 0.0 ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+        }
+        return -400.0 * std::log10(1.0 / score - 1.0);
+    }
+
+    const std::array<Engine, 2>& _engines;
+    const std::vector<State>&    _openings;
+
+    std::mutex                   _mutex;
+    std::array<Results, 2>       _results;
+    std::atomic<size_t>          _next;
+    std::atomic<size_t>          _done;
+};
+
+// Engine options from "depth=6,time=0,ordering=3,window=1,forced=-10000,double=1000,trap=100,factor=1.5",
+// every key optional, false on a value that is not a number or out of range,
+// the weights checked by Weights::isValid
+static bool parseEngine(const std::string& name, Tournament::Engine& engine)
+{
+    engine.name = name;
+    engine.options.threads = 1; // the games are played in parallel, each search on one thread
+
+    std::istringstream stream(name);
+    std::string field;
+    try
+    {
+        while (std::getline(stream, field, ','))
+        {
+            const size_t equal {field.find('=')};
+            if (equal == std::string::npos)
+            {
+                return false;
+            }
+            const std::string key {field.substr(0, equal)};
+            const std::string value {field.substr(equal + 1)};
+            if (key == "depth")
+            {
+                engine.options.recursionLevel = std::stoul(value);
+            }
+            else if (key == "time")
+            {
+                engine.options.moveTime = std::chrono::milliseconds{std::stoul(value)};
+            }
+            else if (key == "ordering")
+            {
+                const unsigned long ordering {std::stoul(value)};
+                if (ordering > static_cast<unsigned long>(Computer::Ordering::HISTORY))
+                {
+                    return false;
+                }
+                engine.options.ordering = static_cast<Computer::Ordering>(ordering);
+            }
+            else if (key == "window")
+            {
+                const unsigned long window {std::stoul(value)};
+                if (window > static_cast<unsigned long>(Computer::Window::MTDF))
+                {
+                    return false;
+                }
+                engine.options.window = static_cast<Computer::Window>(window);
+            }
+            else if (key == "forced")
+            {
+                engine.options.weights.forcedMove = std::stoi(value);
+            }
+            else if (key == "double")
+            {
+                engine.options.weights.doubleTrapMove = std::stoi(value);
+            }
+            else if (key == "trap")
+            {
+                engine.options.weights.trapMove = std::stoi(value);
+            }
+            else if (key == "factor")
+            {
+                engine.options.weights.recursionFactor = std::stod(value);
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+    // std::invalid_argument and std::out_of_range of the conversions
+    catch (const std::logic_error&)
+    {
+        return false;
+    }
+    return engine.options.weights.isValid();
+}
+
+// Every position of plies stones, the game not done, each position once
+static std::vector<State> getOpenings(const unsigned plies)
+{
+    std::vector<State> ply {State(P1)};
+    for (unsigned stones=0; stones < plies; ++stones)
+    {
+        std::vector<State> nextPly;
+        std::unordered_set<uint64_t> keys;
+        for (State& state : ply)
+        {
+            for (unsigned col=0; col < WIDTH; ++col)
+            {
+                if (!state.isColValid(col))
+                {
+                    continue;
+                }
+                state.addPosition(col);
+                if (!state.isDone() && keys.insert(state.getBoard().getHash()).second)
+                {
+                    nextPly.push_back(state);
+                }
+                state.undoPosition();
+            }
+        }
+        ply.swap(nextPly);
+    }
+    return ply;
+}
+
+// One opening per line, as the columns played from 1 to WIDTH
+static bool readOpenings(const std::string& fileName, std::vector<State>& openings)
+{
+    std::ifstream file(fileName);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        State state(P1);
+        if (!state.addPositions(line))
+        {
+            return false;
+        }
+        if (!state.isDone())
+        {
+            openings.push_back(state);
+        }
+    }
+    return file.eof();
+}
+
+int main(int argc, char** argv)
+{
+    std::array<Tournament::Engine, 2> engines;
+    if (argc < 3 || !parseEngine(argv[1], engines[0]) || !parseEngine(argv[2], engines[1]))
+    {
+        std::cout << "USAGE: " << argv[0] << " ENGINE_A ENGINE_B [OPENING_PLIES|OPENINGS_FILE] [THREADS] [TABLE_MB]\n"
+                  << "ENGINE: key=value,... of depth, time (ms), ordering (0-4), window (0-3), forced, double, trap, factor\n"
+                  << "WEIGHTS: forced, double and trap distinct, non zero and strictly between -1000000 and 1000000, factor from 1 to 214\n";
+        return 1;
+    }
+
+    std::vector<State> openings;
+    const std::string openingsArg {argc > 3 ? argv[3] : "2"};
+    if (openingsArg.find_first_not_of("0123456789") == std::string::npos)
+    {
+        openings = getOpenings(std::stoul(openingsArg));
+    }
+    else if (!readOpenings(openingsArg, openings))
+    {
+        std::cout << "CANNOT READ " << openingsArg << "\n";
+        return 1;
+    }
+
+    Computer::Options options;
+    options.threads = 1;
+    if (argc > 5)
+    {
+        options.tableSize = std::stoul(argv[5]) << 20;
+    }
+    Computer::setup(options);
+
+    const unsigned threadCount {argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : std::max(1u, std::thread::hardware_concurrency())};
+
+    Tournament tournament(engines, openings);
+    tournament.run(threadCount);
+    tournament.report(std::cout);
+
+    return 0;
+}
@@ -0,0 +1,257 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include "telemetry.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+
+// Fixed-size hash table of search results, BUCKET_SIZE entries per cache line.
+// It is lock-free: an entry is packed in one data word, stored next to
+// key ^ data. A slot torn by two threads writing at once fails the key
+// check and reads as a miss.
+struct TranspositionTable
+{
+    enum class Bound : uint8_t
+    {
+        NONE,   // empty entry
+        EXACT,
+        LOWER,  // score >= beta
+        UPPER,  // score <= alpha
+        FINAL   // evaluation short-circuit, valid at any depth
+    };
+
+    enum class Replacement : uint8_t
+    {
+        ALWAYS,    // the new entry always takes the slot of its key hash
+        DEPTH,     // the shallowest entry of the bucket is replaced
+        AGE_DEPTH  // entries from older searches go first, then the shallowest
+    };
+
+    struct Entry
+    {
+        uint64_t key;
+        int32_t  score;
+        uint8_t  depth;
+        Bound    bound;
+        uint8_t  bestCol;
+        uint8_t  age;
+    };
+    static_assert(sizeof(Entry) == 16, "entry must stay 16 bytes");
+
+    static constexpr unsigned BUCKET_SIZE {4};
+
+    struct Slot
+    {
+        std::atomic<uint64_t> check; // key ^ data
+        std::atomic<uint64_t> data;  // packed entry, 0 when empty
+    };
+
+    struct alignas(64) Bucket : std::array<Slot, BUCKET_SIZE>
+    {};
+    static_assert(sizeof(Bucket) == 64, "bucket must fill one cache line");
+
+    // probes and hits are counted by the Telemetry of the probing threads
+    struct Stats
+    {
+        size_t used;
+        size_t capacity;
+
+        double getOccupancy() const
+        {
+            return capacity == 0 ? 0.0 : static_cast<double>(used) / capacity;
+        }
+
+        friend std::ostream& operator<<(std::ostream& os, const Stats& stats)
+        {
+            os << "TT occupancy=" << 100.0 * stats.getOccupancy() << "% (" << stats.used << "/" << stats.capacity << ")";
+            return os;
+        }
+    };
+
+    TranspositionTable() : _bucketCount(0), _replacement(Replacement::AGE_DEPTH), _age(0), _used(0)
+    {}
+
+    // the bucket count is the largest power of two fitting in bytes, 0 disables the table
+    void resize(size_t bytes, Replacement replacement)
+    {
+        _replacement = replacement;
+
+        size_t bucketCount {0};
+        if (bytes >= sizeof(Bucket))
+        {
+            bucketCount = 1;
+            while (bucketCount * 2 * sizeof(Bucket) <= bytes)
+            {
+                bucketCount *= 2;
+            }
+        }
+
+        if (bucketCount != _bucketCount)
+        {
+            _buckets.reset(bucketCount == 0 ? nullptr : new Bucket[bucketCount]);
+            _bucketCount = bucketCount;
+            clear();
+        }
+    }
+
+    void clear()
+    {
+        for (size_t index=0; index < _bucketCount; ++index)
+        {
+            for (Slot& slot : _buckets[index])
+            {
+                slot.check.store(0, std::memory_order_relaxed);
+                slot.data.store(0, std::memory_order_relaxed);
+            }
+        }
+        _used = 0;
+    }
+
+    // called once per search, ages the entries
+    void newSearch()
+    {
+        ++_age;
+    }
+
+    bool probe(uint64_t key, Entry& result)
+    {
+        if (_bucketCount == 0)
+        {
+            return false;
+        }
+
+        Telemetry::ThreadTelemetry& telemetry {Telemetry::get()};
+        telemetry.tableProbes.add();
+        for (const Slot& slot : getBucket(key))
+        {
+            const uint64_t data {slot.data.load(std::memory_order_relaxed)};
+            if (data != 0 && (slot.check.load(std::memory_order_relaxed) ^ data) == key)
+            {
+                telemetry.tableHits.add();
+                result = unpack(key, data);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void store(uint64_t key, int score, unsigned depth, Bound bound, unsigned bestCol)
+    {
+        if (_bucketCount == 0)
+        {
+            return;
+        }
+
+        Bucket& bucket {getBucket(key)};
+        Slot* slot {nullptr};
+        for (Slot& candidate : bucket)
+        {
+            const uint64_t data {candidate.data.load(std::memory_order_relaxed)};
+            if (data != 0 && (candidate.check.load(std::memory_order_relaxed) ^ data) == key)
+            {
+                slot = &candidate;
+                break;
+            }
+        }
+
+        if (slot == nullptr)
+        {
+            slot = getVictim(bucket, key);
+            if (slot->data.load(std::memory_order_relaxed) == 0)
+            {
+                _used.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        const uint64_t data {pack(Entry{key, score, static_cast<uint8_t>(depth), bound, static_cast<uint8_t>(bestCol), _age})};
+        slot->data.store(data, std::memory_order_relaxed);
+        slot->check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    Stats getStats() const
+    {
+        return Stats{_used, _bucketCount * BUCKET_SIZE};
+    }
+
+private:
+    static uint64_t pack(const Entry& entry)
+    {
+        return static_cast<uint64_t>(static_cast<uint32_t>(entry.score)) |
+               static_cast<uint64_t>(entry.depth) << 32 |
+               static_cast<uint64_t>(entry.bound) << 40 |
+               static_cast<uint64_t>(entry.bestCol) << 48 |
+               static_cast<uint64_t>(entry.age) << 56;
+    }
+
+    static Entry unpack(uint64_t key, uint64_t data)
+    {
+        return Entry{key,
+                     static_cast<int32_t>(static_cast<uint32_t>(data)),
+                     static_cast<uint8_t>(data >> 32),
+                     static_cast<Bound>(static_cast<uint8_t>(data >> 40)),
+                     static_cast<uint8_t>(data >> 48),
+                     static_cast<uint8_t>(data >> 56)};
+    }
+
+    size_t getIndex(uint64_t key) const
+    {
+        return (getHash(key) >> 32) & (_bucketCount - 1);
+    }
+
+    Bucket& getBucket(uint64_t key) const
+    {
+        return _buckets[getIndex(key)];
+    }
+
+    static uint64_t getHash(uint64_t key)
+    {
+        return key * 0x9E3779B97F4A7C15ull;
+    }
+
+    Slot* getVictim(Bucket& bucket, uint64_t key) const
+    {
+        for (Slot& slot : bucket)
+        {
+            if (slot.data.load(std::memory_order_relaxed) == 0)
+            {
+                return &slot;
+            }
+        }
+
+        if (_replacement == Replacement::ALWAYS)
+        {
+            return &bucket[(getHash(key) >> 24) % BUCKET_SIZE];
+        }
+
+        Slot* victim {&bucket[0]};
+        Entry victimEntry {unpack(0, victim->data.load(std::memory_order_relaxed))};
+        for (Slot& slot : bucket)
+        {
+            const Entry entry {unpack(0, slot.data.load(std::memory_order_relaxed))};
+            bool replace {entry.depth < victimEntry.depth};
+            if (_replacement == Replacement::AGE_DEPTH && (entry.age != _age) != (victimEntry.age != _age))
+            {
+                replace = entry.age != _age;
+            }
+            if (replace)
+            {
+                victim = &slot;
+                victimEntry = entry;
+            }
+        }
+        return victim;
+    }
+
+    std::unique_ptr<Bucket[]> _buckets;
+    size_t                    _bucketCount;
+    Replacement               _replacement;
+    uint8_t                   _age;
+
+    std::atomic<size_t>       _used;
+};
+
+#endif